@@ -0,0 +1,93 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+ * Every allocation is aligned to this, which is enough for anything the game
+ * keeps in an arena.
+ */
+#define ARENA_ALIGN 16
+
+/*
+ * Returns size bytes of zeroed memory from the arena, or NULL if there isn't
+ * enough room left.
+ */
+void *
+arenaAlloc(struct arena *arena, size_t size)
+{
+	void *p;
+
+	size = arenaSize(size);
+	if (size > arena->size - arena->used) {
+		return NULL;
+	}
+	p = arena->base + arena->used;
+	arena->used += size;
+	memset(p, 0, size);
+	return p;
+}
+
+/*
+ * Gives the memory of the arena back to the system.
+ */
+void
+arenaFree(struct arena *arena)
+{
+	free(arena->base);
+	arena->base = NULL;
+	arena->size = 0;
+	arena->used = 0;
+}
+
+/*
+ * Sets up an arena with room for size bytes. Returns 0 on success, or -1 if
+ * there isn't enough memory.
+ */
+int
+arenaInit(struct arena *arena, size_t size)
+{
+	arena->used = 0;
+	arena->size = size;
+	if ((arena->base = malloc(size > 0 ? size : 1)) == NULL) {
+		arena->size = 0;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Takes back everything handed out from the arena.
+ */
+void
+arenaReset(struct arena *arena)
+{
+	arena->used = 0;
+}
+
+/*
+ * Returns how much of an arena an allocation of size bytes takes up.
+ */
+size_t
+arenaSize(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
@@ -0,0 +1,44 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A simple arena allocator. Memory is handed out from one block, one piece
+ * after another, and is all given back at once, so that nothing has to be
+ * allocated (or freed) while the game is running.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena {
+	unsigned char *base;
+	size_t size;
+
+	/* How much of the arena has been handed out. */
+	size_t used;
+};
+
+void *arenaAlloc(struct arena *arena, size_t size);
+void arenaFree(struct arena *arena);
+int arenaInit(struct arena *arena, size_t size);
+void arenaReset(struct arena *arena);
+size_t arenaSize(size_t size);
+
+#endif /* ARENA_H */
@@ -0,0 +1,219 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "autopilot.h"
+
+/*
+ * Two seconds.
+ */
+const unsigned long AUTOPILOT_MESSAGE_FRAMES = 400;
+
+static void autopilotAnykey(struct input *in);
+static unsigned long autopilotDue(struct input *in);
+static void autopilotRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void autopilotResume(struct input *in, unsigned long frame);
+static void autopilotWait(struct input *in, unsigned long frame);
+static int landingColumn(const struct game *game, int i, long long frames);
+static int target(struct autopilot *autopilot, unsigned long frame);
+
+/*
+ * Leaves the message up until the frame AUTOPILOT_MESSAGE_FRAMES from now is
+ * due, or a key the game knows is pressed. Once the player has quit, there is
+ * nothing to wait for.
+ */
+static void
+autopilotAnykey(struct input *in)
+{
+	struct autopilot *autopilot = (struct autopilot *)in;
+	struct input *source = autopilot->source;
+	struct renderer *renderer = autopilot->game->renderer;
+	const unsigned long until = source->due(source)
+		+ AUTOPILOT_MESSAGE_FRAMES;
+
+	while (!autopilot->quit && source->due(source) < until) {
+		struct controls controls;
+		/* The message might have been held back, if the terminal is
+		 * behind, so it is sent again each time around until it
+		 * goes out. */
+		renderer->present(renderer);
+		source->wait(source, until);
+		source->read(source, &controls, source->due(source) + 1, 0);
+		autopilot->quit = controls.quit;
+		if (controls.direction != 0 || controls.togglePause
+				|| controls.quit || controls.redraw) {
+			return;
+		}
+	}
+}
+
+static unsigned long
+autopilotDue(struct input *in)
+{
+	struct autopilot *autopilot = (struct autopilot *)in;
+
+	return autopilot->source->due(autopilot->source);
+}
+
+/*
+ * Reads the controls from source, but moves the paddle towards the column
+ * target() picks instead of wherever source says. The paddle never stops, so
+ * once it is there it turns around, and wobbles about under it.
+ */
+static void
+autopilotRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused)
+{
+	struct autopilot *autopilot = (struct autopilot *)in;
+	const struct paddle *paddle = autopilot->game->paddle;
+
+	autopilot->source->read(autopilot->source, controls, frame, isPaused);
+	controls->quit |= autopilot->quit;
+	controls->direction = 0;
+	if (isPaused || autopilot->game->balls.count == 0) {
+		return;
+	}
+
+	const int column = target(autopilot, frame);
+	const int middle = paddle->x + paddle->len / 2;
+	if (column < middle) {
+		controls->direction = -1;
+	} else if (column > middle) {
+		controls->direction = 1;
+	} else {
+		controls->direction = -paddle->direction;
+	}
+}
+
+static void
+autopilotResume(struct input *in, unsigned long frame)
+{
+	struct autopilot *autopilot = (struct autopilot *)in;
+
+	autopilot->source->resume(autopilot->source, frame);
+}
+
+static void
+autopilotWait(struct input *in, unsigned long frame)
+{
+	struct autopilot *autopilot = (struct autopilot *)in;
+
+	autopilot->source->wait(autopilot->source, frame);
+}
+
+/*
+ * Returns the column ball i will be in after the given number of frames, if
+ * nothing but the walls gets in its way. Each leg of the way from one wall to
+ * the other is worked out at once, the same way checkBalls() moves it: the
+ * ball bounces on the frame it would cross the wall, and ends that frame just
+ * inside it.
+ */
+static int
+landingColumn(const struct game *game, int i, long long frames)
+{
+	const long long right = (long long)game->width * FIXED_ONE;
+	long long fx = game->balls.fx[i];
+	long long dx = game->balls.dx[i];
+
+	while (frames > 0) {
+		/* The frames until the ball would cross the wall it is
+		 * heading for, counting the one it bounces on. */
+		const long long leg = dx > 0 ? (right - fx + dx - 1) / dx
+			: fx / -dx + 1;
+		if (leg > frames) {
+			fx += dx * frames;
+			break;
+		}
+		frames -= leg;
+		fx = dx > 0 ? right - 1 : 0;
+		dx = -dx;
+	}
+	return (int)(fx / FIXED_ONE);
+}
+
+/*
+ * Sets up autopilot to play game, with everything but the paddle coming from
+ * source, and the clock too.
+ */
+void
+startAutopilot(struct autopilot *autopilot, struct input *source,
+		const struct game *game)
+{
+	autopilot->input.due = autopilotDue;
+	autopilot->input.wait = autopilotWait;
+	autopilot->input.read = autopilotRead;
+	autopilot->input.resume = autopilotResume;
+	autopilot->input.anykey = autopilotAnykey;
+	autopilot->source = source;
+	autopilot->game = game;
+	autopilot->ball = -1;
+	autopilot->quit = 0;
+}
+
+/*
+ * Returns the column the paddle should be under going into frame: where the
+ * first ball to come down to it will land, or if none are coming down, under
+ * the lowest one. Where a ball lands is only worked out again once it has
+ * changed course, or another ball is the first to land.
+ */
+static int
+target(struct autopilot *autopilot, unsigned long frame)
+{
+	const struct game *game = autopilot->game;
+	const struct balls *balls = &game->balls;
+	const long long top = (long long)game->paddle->y * FIXED_ONE;
+	long long soonest = -1;
+	int first = -1, lowest = 0;
+
+	/* How soon each ball gets down to the paddle depends only on how fast
+	 * it is falling, since the walls don't change that. */
+	for (int i = 0; i < balls->count; i++) {
+		if (balls->fy[i] > balls->fy[lowest]) {
+			lowest = i;
+		}
+		if (balls->dy[i] <= 0 || balls->fy[i] >= top) {
+			continue;
+		}
+		const long long frames = (top - balls->fy[i] + balls->dy[i] - 1)
+			/ balls->dy[i];
+		if (first < 0 || frames < soonest) {
+			first = i;
+			soonest = frames;
+		}
+	}
+	if (first < 0) {
+		autopilot->ball = -1;
+		return balls->x[lowest];
+	}
+
+	/* The balls can move around in the arrays, so the landing frame
+	 * having moved is taken as a change of course too. */
+	const unsigned long landing = frame + soonest;
+	if (first != autopilot->ball || balls->dx[first] != autopilot->dx
+			|| balls->dy[first] != autopilot->dy
+			|| labs((long)(landing - autopilot->landing)) > 1) {
+		autopilot->ball = first;
+		autopilot->dx = balls->dx[first];
+		autopilot->dy = balls->dy[first];
+		autopilot->column = landingColumn(game, first, soonest);
+		autopilot->landing = landing;
+	}
+	return autopilot->column;
+}
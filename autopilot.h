@@ -0,0 +1,63 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A player that moves the paddle by itself, for showing the game off with
+ * nobody at the keyboard, and for headless games that get somewhere.
+ */
+
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "game.h"
+
+/*
+ * An input that passes everything through from source, except that it moves
+ * the paddle itself, under wherever the next ball to come down is going to
+ * land. Instead of waiting for a key after a message, it leaves the message up
+ * for a while, unless a key is pressed.
+ */
+struct autopilot {
+	struct input input;
+	struct input *source;
+	const struct game *game;
+
+	/* The last prediction made: which ball it was for, the way the ball
+	 * was going at the time, and the column it will be in when it gets
+	 * down to the paddle, on the frame landing. ball is -1 if there is no
+	 * prediction. */
+	int ball;
+	int dx;
+	int dy;
+	int column;
+	unsigned long landing;
+
+	/* Whether the player quit while a message was up. The game is quit
+	 * the next time the controls are read. */
+	int quit;
+};
+
+/*
+ * How long a message is left up for, in frames.
+ */
+extern const unsigned long AUTOPILOT_MESSAGE_FRAMES;
+
+void startAutopilot(struct autopilot *autopilot, struct input *source,
+		const struct game *game);
+
+#endif /* AUTOPILOT_H */
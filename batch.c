@@ -0,0 +1,317 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "autopilot.h"
+#include "batch.h"
+#include "game.h"
+#include "headless.h"
+#include "snapshot.h"
+
+/*
+ * The games of a batch are handed out to the workers in even shares up front.
+ * A worker that runs out steals half of what is left of somebody else's
+ * share, so that a few long games don't leave the other threads idle at the
+ * end.
+ */
+struct worker {
+	pthread_t thread;
+	struct batch *batch;
+
+	/* The games this worker has left to play, as indices into results,
+	 * from begin up to (but not including) end. The worker takes games
+	 * from the front, and thieves take them from the back. */
+	pthread_mutex_t lock;
+	unsigned long begin;
+	unsigned long end;
+};
+
+/*
+ * Everything the workers of a batch share. None of it changes while they are
+ * running, apart from results, which each game writes its own entry of.
+ */
+struct batch {
+	struct worker *workers;
+	int count;
+
+	struct result *results;
+	uint64_t firstSeed;
+	int level;
+	struct rules rules;
+	unsigned long limit;
+
+	/* Whether the games are played by the autopilot, rather than by
+	 * nobody. */
+	int ai;
+
+	/* The snapshot every game carries on from, or NULL if they start
+	 * from scratch. */
+	const struct snapshot *from;
+};
+
+static void playOne(struct batch *batch, unsigned long i);
+static int stealGames(struct worker *worker);
+static int takeGame(struct worker *worker, unsigned long *i);
+static void *work(void *arg);
+
+/*
+ * Plays game i of the batch and writes down how it went. If there isn't
+ * enough memory for the game, it is counted as unfinished, without any frames.
+ */
+static void
+playOne(struct batch *batch, unsigned long i)
+{
+	struct headless input;
+	struct autopilot autopilot;
+	struct game game;
+
+	initHeadless(&input, batch->limit);
+	startAutopilot(&autopilot, &input.input, &game);
+	struct input *in = batch->ai ? &autopilot.input : &input.input;
+	const int error = batch->from != NULL
+		? resumeGame(&game, batch->from, batch->rules.levels,
+				&nullRenderer, in)
+		: initGame(&game, &batch->rules, batch->level,
+				batch->firstSeed + i, &nullRenderer, in);
+	if (error != 0) {
+		batch->results[i].seed = batch->firstSeed + i;
+		batch->results[i].level = batch->level;
+		batch->results[i].finished = 0;
+		return;
+	}
+	if (batch->from != NULL) {
+		/* Each game goes its own way from the snapshot. */
+		game.seed = batch->firstSeed + i;
+		rngSeed(&game.rng, game.seed);
+	}
+	playGame(&game);
+	freeGame(&game);
+
+	batch->results[i].seed = game.seed;
+	batch->results[i].score = game.score;
+	batch->results[i].level = game.level;
+	batch->results[i].frames = game.frames;
+	batch->results[i].blocksDestroyed = game.blocksDestroyed;
+	batch->results[i].finished = !input.stopped;
+}
+
+/*
+ * Prints the number of games in results and how many of them didn't finish,
+ * and the mean, minimum and maximum of each of the results, followed by how
+ * many games ended on each level.
+ */
+void
+printSummary(FILE *file, const struct result *results, unsigned long count)
+{
+	double sum[4] = { 0 };
+	double low[4], high[4];
+	const char *names[4] = { "score", "level", "frames", "blocks" };
+	int maxLevel = 0;
+	unsigned long unfinished = 0;
+
+	for (unsigned long i = 0; i < count; i++) {
+		unfinished += !results[i].finished;
+	}
+	fprintf(file, "games %lu unfinished %lu\n", count, unfinished);
+	if (count == 0) {
+		return;
+	}
+
+	for (unsigned long i = 0; i < count; i++) {
+		const double values[4] = {
+			results[i].score,
+			results[i].level,
+			results[i].frames,
+			results[i].blocksDestroyed,
+		};
+		for (int j = 0; j < 4; j++) {
+			sum[j] += values[j];
+			if (i == 0 || values[j] < low[j]) {
+				low[j] = values[j];
+			}
+			if (i == 0 || values[j] > high[j]) {
+				high[j] = values[j];
+			}
+		}
+		maxLevel = max(maxLevel, results[i].level);
+	}
+	for (int j = 0; j < 4; j++) {
+		fprintf(file, "%s mean %.2f min %.0f max %.0f\n", names[j],
+				sum[j] / count, low[j], high[j]);
+	}
+
+	/* How far games get is what matters most when tuning the levels. */
+	unsigned long *ended = calloc(maxLevel + 1, sizeof(*ended));
+	if (ended == NULL) {
+		return;
+	}
+	for (unsigned long i = 0; i < count; i++) {
+		if (results[i].level >= 0) {
+			ended[results[i].level]++;
+		}
+	}
+	for (int level = 0; level <= maxLevel; level++) {
+		if (ended[level] != 0) {
+			fprintf(file, "ended level %d games %lu\n", level,
+					ended[level]);
+		}
+	}
+	free(ended);
+}
+
+/*
+ * Plays count headless games, seeded firstSeed, firstSeed + 1, and so on,
+ * all starting at level with the given rules and quit after limit frames
+ * (see struct headless), across *threads threads. If from isn't
+ * NULL, the games all carry on from that snapshot instead, each with its
+ * random number generator seeded again from its own seed. If ai is set, the
+ * games are played by the autopilot. How each game went is written to the
+ * matching entry of results. *threads is set to how many threads the games
+ * were played on, which can be fewer than asked for: no more than there are
+ * games, and only as many as could be started. Returns 0 on success, or ENOMEM
+ * if there isn't enough memory to keep track of the threads.
+ */
+int
+runBatch(struct result *results, unsigned long count, uint64_t firstSeed,
+		int level, const struct rules *rules,
+		const struct snapshot *from, unsigned long limit, int ai,
+		int *threads)
+{
+	struct batch batch;
+	int started;
+	int asked = *threads;
+
+	if (asked < 1) {
+		asked = 1;
+	}
+	if ((unsigned long)asked > count) {
+		asked = count > 0 ? (int)count : 1;
+	}
+
+	if ((batch.workers = calloc(asked, sizeof(*batch.workers))) == NULL) {
+		return ENOMEM;
+	}
+	batch.count = asked;
+	batch.results = results;
+	batch.firstSeed = firstSeed;
+	batch.level = level;
+	batch.rules = *rules;
+	batch.limit = limit;
+	batch.ai = ai;
+	batch.from = from;
+
+	for (int i = 0; i < asked; i++) {
+		struct worker *worker = &batch.workers[i];
+		worker->batch = &batch;
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->begin = count * i / asked;
+		worker->end = count * (i + 1) / asked;
+	}
+
+	/* The calling thread is the first worker, so it doesn't sit idle. */
+	for (started = 1; started < asked; started++) {
+		if (pthread_create(&batch.workers[started].thread, NULL, work,
+				&batch.workers[started]) != 0) {
+			/* The threads that did start will steal the games of
+			 * the ones that didn't. */
+			break;
+		}
+	}
+	work(&batch.workers[0]);
+	for (int i = 1; i < started; i++) {
+		pthread_join(batch.workers[i].thread, NULL);
+	}
+
+	for (int i = 0; i < asked; i++) {
+		pthread_mutex_destroy(&batch.workers[i].lock);
+	}
+	free(batch.workers);
+	*threads = started;
+	return 0;
+}
+
+/*
+ * Moves half of the games left in another worker's share (rounded up) into
+ * worker's. Returns 1 if any were stolen, or 0 if there are none left
+ * anywhere.
+ */
+static int
+stealGames(struct worker *worker)
+{
+	struct batch *batch = worker->batch;
+	const int self = worker - batch->workers;
+
+	for (int i = 1; i < batch->count; i++) {
+		struct worker *victim = &batch->workers[(self + i) % batch->count];
+		unsigned long begin, end;
+
+		pthread_mutex_lock(&victim->lock);
+		end = victim->end;
+		begin = end - (end - victim->begin + 1) / 2;
+		victim->end = begin;
+		pthread_mutex_unlock(&victim->lock);
+
+		if (begin < end) {
+			pthread_mutex_lock(&worker->lock);
+			worker->begin = begin;
+			worker->end = end;
+			pthread_mutex_unlock(&worker->lock);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Takes the next game from the front of worker's share into i. Returns 1 if
+ * there was one, or 0 if the share is empty.
+ */
+static int
+takeGame(struct worker *worker, unsigned long *i)
+{
+	int taken = 0;
+
+	pthread_mutex_lock(&worker->lock);
+	if (worker->begin < worker->end) {
+		*i = worker->begin++;
+		taken = 1;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return taken;
+}
+
+/*
+ * The body of each worker thread: plays games until there are none left.
+ */
+static void *
+work(void *arg)
+{
+	struct worker *worker = arg;
+	unsigned long i;
+
+	for (;;) {
+		if (takeGame(worker, &i)) {
+			playOne(worker->batch, i);
+		} else if (!stealGames(worker)) {
+			return NULL;
+		}
+	}
+}
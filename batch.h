@@ -0,0 +1,58 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Playing lots of headless games at once, spread across several threads, to
+ * see how the game plays out over many seeds.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+#include "snapshot.h"
+
+/*
+ * How a single game of a batch turned out.
+ */
+struct result {
+	uint64_t seed;
+	unsigned int score;
+
+	/* The level the game ended on. */
+	int level;
+
+	unsigned long frames;
+	unsigned long blocksDestroyed;
+
+	/* Whether the game ended on its own, rather than running into the
+	 * frame limit. */
+	int finished;
+};
+
+void printSummary(FILE *file, const struct result *results,
+		unsigned long count);
+int runBatch(struct result *results, unsigned long count,
+		uint64_t firstSeed, int level, const struct rules *rules,
+		const struct snapshot *from, unsigned long limit, int ai,
+		int *threads);
+
+#endif /* BATCH_H */
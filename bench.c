@@ -0,0 +1,843 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks for the parts of the game that have to be fast: simulating it,
+ * drawing it on the terminal, and reading the keyboard. Run with make bench.
+ * Each result is printed on a line of its own, as a name and a number, so
+ * that runs can be compared by a script.
+ *
+ * The boards are random, or come from a level pack given with --levels. With
+ * --make-levels, a pack of random boards is written instead, so that the
+ * benchmarks can be run on the same boards every time.
+ *
+ * With --latency, the game itself is run on a pseudoterminal instead, and
+ * timed from each key pressed to the paddle being seen to move (make latency).
+ */
+
+/* For posix_openpt(), to type into. */
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "headless.h"
+#include "levels.h"
+#include "replay.h"
+#include "rng.h"
+#include "term.h"
+
+/*
+ * From rogueutil, which is built into term.c.
+ */
+int nb_getch(void);
+
+struct screen;
+
+static void benchInput(FILE *out);
+static void benchLatency(FILE *out, char *argv[]);
+static void benchRender(FILE *out, const char *replayPath,
+		const struct levelPack *levels);
+static void benchSimulation(FILE *out, const struct levelPack *levels);
+static int compareLongLong(const void *a, const void *b);
+static void countOutput(off_t from, long long *bytes, long long *escapes);
+static void countPresent(struct renderer *r);
+static void countRedraw(struct renderer *r, const struct game *game);
+static void endGame(int master, pid_t pid);
+static void escape(struct screen *s, char final);
+static void fail(const char *what);
+static void feedScreen(struct screen *s, const char *buf, size_t len);
+static void makeLevels(const char *path);
+static int openMaster(void);
+static int paddleExtent(const struct screen *s, int *left, int *right);
+static int readGame(int master, struct screen *s, long long until);
+static int spawnGame(char *argv[], pid_t *pid);
+static void usage(const char *argv0);
+static long long waitForPaddle(int master, struct screen *s, int direction,
+		long long sent);
+
+/*
+ * The levels the simulation is timed from, and how many games are played from
+ * each.
+ */
+#define LAST_LEVEL 60
+#define GAMES_PER_LEVEL 4
+
+/*
+ * How many keys are pressed to time reading them.
+ */
+#define KEYS 10000
+
+/*
+ * How many key presses the latency is measured over, and how many times the
+ * game can be started over (after the ball is lost for good) to get them.
+ */
+#define LATENCY_SAMPLES 200
+#define MAX_GAMES 50
+
+/*
+ * The longest the paddle is waited for after a key, and the longest wait
+ * between one move being seen and the next key (which is picked at random, so
+ * that keys land at every point of a frame), in nanoseconds.
+ */
+static const long long LATENCY_TIMEOUT = 1000000000;
+static const long long MAX_KEY_GAP = 20000000;
+
+/*
+ * How long the game is given to draw everything after it starts, or after a
+ * key is pressed to get past a message, in nanoseconds.
+ */
+static const long long SETTLE_TIME = 300000000;
+
+/*
+ * What the game has drawn on the pseudoterminal, as far as it matters for
+ * telling where the paddle is. The paddle is the only thing drawn on a magenta
+ * background, so only which cells are magenta is kept track of.
+ */
+#define SCREEN_ROWS 256
+#define SCREEN_COLUMNS 256
+
+struct screen {
+	/* Where the cursor is, counting from 1, and whether the background
+	 * color is magenta. */
+	int x;
+	int y;
+	int magenta;
+
+	/* Whether the screen has been cleared since this was last reset,
+	 * which happens when the game draws everything over. */
+	int cleared;
+
+	/* How far into an escape sequence the output is: 0 outside of one, 1
+	 * after the escape, 2 in a control sequence, whose parameters so far
+	 * are in params. private is set if it is a private one, which only
+	 * ever shows or hides the cursor. */
+	int state;
+	int params[16];
+	int paramCount;
+	int private;
+
+	/* 1 for each cell that is magenta. */
+	unsigned char cells[SCREEN_ROWS][SCREEN_COLUMNS];
+};
+
+/*
+ * The terminal renderer, with present() and redraw() counting what they send.
+ * Everything it sends goes to stdout, which is a temporary file while it is
+ * used, so that it can be read back.
+ */
+static struct renderer countingRenderer;
+static unsigned long frames;
+static long long frameBytes;
+static long long frameEscapes;
+static unsigned long redraws;
+static long long redrawBytes;
+static long long redrawEscapes;
+
+/*
+ * Times how long it takes to read a key that has been pressed, with nb_getch()
+ * and with the terminal input's read(), which is what the game calls every
+ * frame. The keys are typed into a pseudoterminal, which takes stdin's place,
+ * and the terminal's output is thrown away.
+ */
+static void
+benchInput(FILE *out)
+{
+	int master = openMaster();
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	int savedStdin = dup(STDIN_FILENO);
+	if (slave < 0 || savedStdin < 0
+			|| dup2(slave, STDIN_FILENO) < 0) {
+		fail("can't open a pseudoterminal");
+	}
+	int null = open("/dev/null", O_WRONLY);
+	int savedStdout = dup(STDOUT_FILENO);
+	if (null < 0 || savedStdout < 0 || dup2(null, STDOUT_FILENO) < 0) {
+		fail("/dev/null");
+	}
+	if (terminalBegin(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0, 0, NULL, 0) != 0) {
+		fail("can't set up the terminal");
+	}
+
+	/* It takes the pseudoterminal a moment to pass each key along, so it
+	 * is waited for before the clock starts. */
+	struct pollfd p = { STDIN_FILENO, POLLIN, 0 };
+	long long waiting = 0, idle = 0, read = 0;
+	for (int i = 0; i < KEYS; i++) {
+		if (write(master, "j", 1) != 1) {
+			fail("can't type into the pseudoterminal");
+		}
+		poll(&p, 1, -1);
+		long long start = monotonicTime();
+		nb_getch();
+		long long middle = monotonicTime();
+		nb_getch();
+		idle += monotonicTime() - middle;
+		waiting += middle - start;
+	}
+	for (int i = 0; i < KEYS; i++) {
+		struct controls controls;
+		if (write(master, "j", 1) != 1) {
+			fail("can't type into the pseudoterminal");
+		}
+		poll(&p, 1, -1);
+		long long start = monotonicTime();
+		terminalInput.read(&terminalInput, &controls, 1, 0);
+		read += monotonicTime() - start;
+	}
+
+	terminalEnd();
+	dup2(savedStdin, STDIN_FILENO);
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdin);
+	close(savedStdout);
+	close(null);
+	close(slave);
+	close(master);
+
+	fprintf(out, "input.nb_getch.ns %.0f\n", (double)waiting / KEYS);
+	fprintf(out, "input.nb_getch_idle.ns %.0f\n", (double)idle / KEYS);
+	fprintf(out, "input.read.ns %.0f\n", (double)read / KEYS);
+}
+
+/*
+ * Runs the game in argv on a pseudoterminal, presses j and k by turns, and
+ * times how long it takes from each key being pressed to the paddle being
+ * drawn moving that way. That takes in everything between the keyboard and
+ * the screen: waiting for input, the paddle only moving every few frames, and
+ * sending the screen. Key presses that get lost, to a message or the end of a
+ * life, are counted as missed.
+ */
+static void
+benchLatency(FILE *out, char *argv[])
+{
+	static struct screen screen;
+	long long *samples = malloc(LATENCY_SAMPLES * sizeof(*samples));
+	int count = 0, missed = 0, games = 0, direction = -1;
+	int master = -1;
+	pid_t pid = 0;
+
+	if (samples == NULL) {
+		fail("can't keep the results");
+	}
+	while (count < LATENCY_SAMPLES) {
+		if (master < 0) {
+			if (++games > MAX_GAMES) {
+				errno = 0;
+				fail("the game keeps ending");
+			}
+			master = spawnGame(argv, &pid);
+			memset(&screen, 0, sizeof(screen));
+			/* The game starts with a message up. */
+			if (readGame(master, &screen, monotonicTime()
+					+ SETTLE_TIME) != 0
+					|| write(master, " ", 1) != 1
+					|| readGame(master, &screen,
+					monotonicTime() + SETTLE_TIME) != 0) {
+				endGame(master, pid);
+				master = -1;
+				continue;
+			}
+			screen.cleared = 0;
+		}
+
+		const long long sent = monotonicTime();
+		if (write(master, direction < 0 ? "j" : "k", 1) != 1) {
+			fail("can't type into the pseudoterminal");
+		}
+		const long long latency = waitForPaddle(master, &screen,
+				direction, sent);
+		if (latency >= 0) {
+			samples[count++] = latency;
+		} else {
+			missed++;
+			if (latency == -1) {
+				endGame(master, pid);
+				master = -1;
+				continue;
+			}
+			/* The key went to a message, or the paddle was drawn
+			 * over from scratch. Get rid of whatever is up, and
+			 * start again from what is there after that. */
+			if (write(master, " ", 1) != 1
+					|| readGame(master, &screen,
+					monotonicTime() + SETTLE_TIME) != 0) {
+				endGame(master, pid);
+				master = -1;
+				continue;
+			}
+			screen.cleared = 0;
+		}
+		direction = -direction;
+		if (readGame(master, &screen, monotonicTime()
+				+ rand() % MAX_KEY_GAP) != 0) {
+			endGame(master, pid);
+			master = -1;
+		}
+	}
+	if (master >= 0) {
+		endGame(master, pid);
+	}
+
+	qsort(samples, count, sizeof(*samples), compareLongLong);
+	long long total = 0;
+	for (int i = 0; i < count; i++) {
+		total += samples[i];
+	}
+	fprintf(out, "latency.samples %d\n", count);
+	fprintf(out, "latency.missed %d\n", missed);
+	fprintf(out, "latency.mean.us %.0f\n", total / 1e3 / count);
+	const int percentiles[] = { 0, 10, 25, 50, 75, 90, 99 };
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(*percentiles);
+			i++) {
+		fprintf(out, "latency.p%02d.us %.0f\n", percentiles[i],
+				samples[count * percentiles[i] / 100] / 1e3);
+	}
+	fprintf(out, "latency.max.us %.0f\n", samples[count - 1] / 1e3);
+	free(samples);
+}
+
+/*
+ * Plays a game on the terminal renderer, and counts the bytes and escape
+ * sequences sent to draw the whole screen over, and to draw each frame. The
+ * game is played back from replayPath, or if that is NULL, played headless
+ * from seed 1, with the boards from levels, unless that is NULL.
+ */
+static void
+benchRender(FILE *out, const char *replayPath,
+		const struct levelPack *levels)
+{
+	uint64_t seed = 1;
+	int level = 1;
+	struct rules rules = { DEFAULT_WIDTH, DEFAULT_HEIGHT, 1, 0, levels };
+	struct headless headless;
+	struct input *input = &headless.input;
+	struct replay replay;
+
+	initHeadless(&headless, HEADLESS_FRAME_LIMIT);
+	if (replayPath != NULL) {
+		if (startReplay(&replay, input, replayPath, &seed, &level,
+				&rules) != 0) {
+			fail(replayPath);
+		}
+		input = &replay.input;
+	}
+
+	FILE *sink = tmpfile();
+	int savedStdout = dup(STDOUT_FILENO);
+	if (sink == NULL || savedStdout < 0
+			|| dup2(fileno(sink), STDOUT_FILENO) < 0) {
+		fail("can't make a file to draw into");
+	}
+	countingRenderer = terminalRenderer;
+	countingRenderer.present = countPresent;
+	countingRenderer.redraw = countRedraw;
+
+	struct game game;
+	if (initGame(&game, &rules, level, seed, &countingRenderer, input)
+			!= 0) {
+		fail("can't start a game");
+	}
+	if (terminalBegin(rules.width, rules.height, 0, 0, NULL, 0) != 0) {
+		fail("can't set up the terminal");
+	}
+	playGame(&game);
+	terminalEnd();
+	freeGame(&game);
+	if (replayPath != NULL) {
+		stopReplay(&replay);
+	}
+
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdout);
+	fclose(sink);
+
+	fprintf(out, "render.redraws %lu\n", redraws);
+	fprintf(out, "render.redraw.bytes %.0f\n",
+			redraws ? (double)redrawBytes / redraws : 0.0);
+	fprintf(out, "render.redraw.escapes %.0f\n",
+			redraws ? (double)redrawEscapes / redraws : 0.0);
+	fprintf(out, "render.frames %lu\n", frames);
+	fprintf(out, "render.frame.bytes %.1f\n",
+			frames ? (double)frameBytes / frames : 0.0);
+	fprintf(out, "render.frame.escapes %.1f\n",
+			frames ? (double)frameEscapes / frames : 0.0);
+}
+
+/*
+ * Times the simulation: how many frames a second are simulated in headless
+ * games starting from each level, with the boards from levels, unless that is
+ * NULL.
+ */
+static void
+benchSimulation(FILE *out, const struct levelPack *levels)
+{
+	const struct rules rules = {
+		DEFAULT_WIDTH, DEFAULT_HEIGHT, 1, 0, levels
+	};
+
+	for (int level = 1; level <= LAST_LEVEL; level++) {
+		unsigned long simulated = 0;
+		long long start = monotonicTime();
+		for (uint64_t seed = 1; seed <= GAMES_PER_LEVEL; seed++) {
+			struct headless headless;
+			struct game game;
+			initHeadless(&headless, HEADLESS_FRAME_LIMIT);
+			if (initGame(&game, &rules, level, seed, &nullRenderer,
+					&headless.input) != 0) {
+				fail("can't start a game");
+			}
+			playGame(&game);
+			simulated += game.frames;
+			freeGame(&game);
+		}
+		double seconds = (monotonicTime() - start) / 1e9;
+		fprintf(out, "sim.level%02d.fps %.0f\n", level,
+				simulated / seconds);
+	}
+}
+
+/*
+ * Orders long longs for qsort(3), from lowest to highest.
+ */
+static int
+compareLongLong(const void *a, const void *b)
+{
+	const long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Adds the bytes written to stdout since the offset from to bytes, and the
+ * escape sequences among them to escapes.
+ */
+static void
+countOutput(off_t from, long long *bytes, long long *escapes)
+{
+	char buf[4096];
+	const off_t to = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+
+	*bytes += to - from;
+	while (from < to) {
+		size_t n = to - from < (off_t)sizeof(buf) ? (size_t)(to - from)
+			: sizeof(buf);
+		ssize_t got = pread(STDOUT_FILENO, buf, n, from);
+		if (got <= 0) {
+			fail("can't read back what was drawn");
+		}
+		for (ssize_t i = 0; i < got; i++) {
+			*escapes += buf[i] == '\033';
+		}
+		from += got;
+	}
+}
+
+static void
+countPresent(struct renderer *r)
+{
+	const off_t from = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+
+	terminalRenderer.present(r);
+	countOutput(from, &frameBytes, &frameEscapes);
+	frames++;
+}
+
+static void
+countRedraw(struct renderer *r, const struct game *game)
+{
+	const off_t from = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+
+	terminalRenderer.redraw(r, game);
+	countOutput(from, &redrawBytes, &redrawEscapes);
+	redraws++;
+}
+
+/*
+ * Stops the game that was started by spawnGame().
+ */
+static void
+endGame(int master, pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	close(master);
+}
+
+/*
+ * Acts on the control sequence ending in final that was just read into s.
+ * Only the ones the game sends are understood.
+ */
+static void
+escape(struct screen *s, char final)
+{
+	const int n = s->paramCount > 0 && s->params[0] > 0 ? s->params[0]
+		: 1;
+
+	if (s->private) {
+		return;
+	}
+	switch (final) {
+	case 'A':
+		s->y -= n;
+		break;
+	case 'B':
+		s->y += n;
+		break;
+	case 'C':
+		s->x += n;
+		break;
+	case 'D':
+		s->x -= n;
+		break;
+	case 'H':
+	case 'f':
+		s->y = n;
+		s->x = s->paramCount > 1 && s->params[1] > 0 ? s->params[1]
+			: 1;
+		break;
+	case 'J':
+		memset(s->cells, 0, sizeof(s->cells));
+		s->cleared = 1;
+		break;
+	case 'm':
+		if (s->paramCount == 0) {
+			s->magenta = 0;
+		}
+		for (int i = 0; i < s->paramCount; i++) {
+			const int p = s->params[i];
+			if (p == 0 || p == 49 || (p >= 40 && p <= 47)
+					|| (p >= 100 && p <= 107)) {
+				s->magenta = p == 45;
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Gives up on the benchmarks, saying what went wrong.
+ */
+static void
+fail(const char *what)
+{
+	fprintf(stderr, "bench: %s: %s\n", what, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Keeps track of what the game drew, from the next len bytes it sent.
+ */
+static void
+feedScreen(struct screen *s, const char *buf, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		const char c = buf[i];
+
+		if (s->state == 1) {
+			s->state = c == '[' ? 2 : 0;
+			s->paramCount = 0;
+			s->private = 0;
+		} else if (s->state == 2) {
+			if (c >= '0' && c <= '9') {
+				if (s->paramCount == 0) {
+					s->params[s->paramCount++] = 0;
+				}
+				int *p = &s->params[s->paramCount - 1];
+				*p = *p * 10 + (c - '0');
+			} else if (c == ';') {
+				if (s->paramCount == 0) {
+					s->params[s->paramCount++] = 0;
+				}
+				if (s->paramCount < 16) {
+					s->params[s->paramCount++] = 0;
+				}
+			} else if (c == '?') {
+				s->private = 1;
+			} else {
+				escape(s, c);
+				s->state = 0;
+			}
+		} else if (c == '\033') {
+			s->state = 1;
+		} else if (c == '\r') {
+			s->x = 1;
+		} else if (c == '\n') {
+			s->y++;
+		} else if (c == '\b') {
+			s->x--;
+		} else if ((unsigned char)c >= ' ') {
+			if (s->x >= 1 && s->x <= SCREEN_COLUMNS && s->y >= 1
+					&& s->y <= SCREEN_ROWS) {
+				s->cells[s->y - 1][s->x - 1] = s->magenta;
+			}
+			s->x++;
+		}
+	}
+}
+
+/*
+ * Writes a pack of LAST_LEVEL random levels to path, each as big as the blocks
+ * of that level of a random board the default size are, with some of the
+ * blocks left out.
+ */
+static void
+makeLevels(const char *path)
+{
+	struct level levels[LAST_LEVEL];
+	unsigned char *blocks[LAST_LEVEL];
+	const int columns = (DEFAULT_WIDTH - 2 * BLOCK_X) / 2;
+	struct rng rng;
+
+	rngSeed(&rng, 1);
+	for (int n = 0; n < LAST_LEVEL; n++) {
+		const int rows = DEFAULT_HEIGHT / 3
+			+ min((n + 1) / 2, DEFAULT_HEIGHT / 2);
+		blocks[n] = calloc(((size_t)columns * rows + 3) / 4, 1);
+		if (blocks[n] == NULL) {
+			fail("can't make the levels");
+		}
+		/* The top three rows are left empty, like on a random
+		 * board. */
+		for (int y = 3; y < rows; y++) {
+			for (int k = 0; k < columns; k++) {
+				const int i = y * columns + k;
+				blocks[n][i / 4] |= rngRange(&rng, 4)
+					<< (2 * (i % 4));
+			}
+		}
+		levels[n].columns = columns;
+		levels[n].rows = rows;
+		levels[n].blocks = blocks[n];
+	}
+	if (writeLevelPack(path, levels, LAST_LEVEL) != 0) {
+		fail(path);
+	}
+	for (int n = 0; n < LAST_LEVEL; n++) {
+		free(blocks[n]);
+	}
+}
+
+/*
+ * Opens the master side of a new pseudoterminal, and returns it.
+ */
+static int
+openMaster(void)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		fail("can't open a pseudoterminal");
+	}
+	return master;
+}
+
+/*
+ * Finds the left-most and right-most columns of the paddle on s. Returns 1,
+ * or 0 if it isn't there.
+ */
+static int
+paddleExtent(const struct screen *s, int *left, int *right)
+{
+	*left = SCREEN_COLUMNS;
+	*right = -1;
+	for (int y = 0; y < SCREEN_ROWS; y++) {
+		for (int x = 0; x < SCREEN_COLUMNS; x++) {
+			if (s->cells[y][x]) {
+				*left = min(*left, x);
+				*right = max(*right, x);
+			}
+		}
+	}
+	return *right >= 0;
+}
+
+/*
+ * Reads what the game sends into s until the time until. Returns 0, or -1 if
+ * the game has quit.
+ */
+static int
+readGame(int master, struct screen *s, long long until)
+{
+	char buf[4096];
+
+	for (long long left; (left = until - monotonicTime()) > 0;) {
+		struct pollfd p = { master, POLLIN, 0 };
+		if (poll(&p, 1, (int)((left + 999999) / 1000000)) <= 0) {
+			continue;
+		}
+		ssize_t n = read(master, buf, sizeof(buf));
+		if (n <= 0) {
+			return -1;
+		}
+		feedScreen(s, buf, n);
+	}
+	return 0;
+}
+
+/*
+ * Starts the program in argv with a new pseudoterminal as its terminal.
+ * Stores its process ID in pid, and returns the master side of the
+ * pseudoterminal.
+ */
+static int
+spawnGame(char *argv[], pid_t *pid)
+{
+	int master = openMaster();
+	const char *slave = ptsname(master);
+
+	*pid = fork();
+	if (*pid < 0) {
+		fail("can't start the game");
+	}
+	if (*pid == 0) {
+		/* Opened in a session of its own, the pseudoterminal becomes
+		 * the game's controlling terminal. */
+		setsid();
+		int fd = open(slave, O_RDWR);
+		if (fd < 0) {
+			_exit(127);
+		}
+		dup2(fd, STDIN_FILENO);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		close(master);
+		if (fd > STDERR_FILENO) {
+			close(fd);
+		}
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	return master;
+}
+
+/*
+ * Prints how to use the benchmarks, and exits unsuccessfully.
+ */
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [--levels file] [replay]\n"
+			"       %s --make-levels file\n"
+			"       %s --latency game [option]...\n",
+			argv0, argv0, argv0);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Reads what the game sends into s until the paddle is drawn moving in
+ * direction, and returns how long after sent that was. The paddle might have
+ * still been going the other way when the key was pressed, so it counts as
+ * turning once it gets past the furthest it has been the other way since.
+ * Returns -1 if the game quit, or -2 if it drew everything over from scratch
+ * or the paddle didn't move in time.
+ */
+static long long
+waitForPaddle(int master, struct screen *s, int direction, long long sent)
+{
+	char buf[4096];
+	int left, right;
+
+	if (!paddleExtent(s, &left, &right)) {
+		return -2;
+	}
+	for (;;) {
+		const long long wait = sent + LATENCY_TIMEOUT - monotonicTime();
+		struct pollfd p = { master, POLLIN, 0 };
+		if (wait <= 0) {
+			return -2;
+		}
+		if (poll(&p, 1, (int)((wait + 999999) / 1000000)) <= 0) {
+			continue;
+		}
+		ssize_t n = read(master, buf, sizeof(buf));
+		const long long now = monotonicTime();
+		if (n <= 0) {
+			return -1;
+		}
+		feedScreen(s, buf, n);
+		int newLeft, newRight;
+		if (s->cleared || !paddleExtent(s, &newLeft, &newRight)) {
+			return -2;
+		}
+		if (direction < 0 ? newLeft < left : newRight > right) {
+			return now - sent;
+		}
+		left = max(left, newLeft);
+		right = min(right, newRight);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const int latency = argc > 2 && strcmp(argv[1], "--latency") == 0;
+	const char *replayPath = NULL;
+	const char *levelsPath = NULL;
+
+	for (int i = 1; i < argc && !latency; i++) {
+		if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+			levelsPath = argv[++i];
+		} else if (strcmp(argv[i], "--make-levels") == 0
+				&& i + 1 < argc && argc == 3) {
+			makeLevels(argv[++i]);
+			return 0;
+		} else if (argv[i][0] != '-' && replayPath == NULL) {
+			replayPath = argv[i];
+		} else {
+			usage(argv[0]);
+		}
+	}
+	/* The terminal output goes elsewhere while it is being measured, so
+	 * the results are written through a stream of their own. */
+	FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL) {
+		fail("can't write the results");
+	}
+	setvbuf(out, NULL, _IOLBF, 0);
+
+	if (latency) {
+		benchLatency(out, argv + 2);
+		fclose(out);
+		return 0;
+	}
+	struct levelPack pack;
+	if (levelsPath != NULL && openLevelPack(&pack, levelsPath) != 0) {
+		fail(levelsPath);
+	}
+	const struct levelPack *levels = levelsPath != NULL ? &pack : NULL;
+
+	benchSimulation(out, levels);
+	benchRender(out, replayPath, levels);
+	benchInput(out);
+
+	if (levels != NULL) {
+		closeLevelPack(&pack);
+	}
+	fclose(out);
+	return 0;
+}
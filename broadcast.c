@@ -0,0 +1,297 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "broadcast.h"
+
+static void acceptViewers(struct broadcast *broadcast);
+static void dropViewer(struct broadcast *broadcast, int i);
+static int sendViewer(struct broadcast *broadcast, struct viewer *viewer);
+
+/*
+ * Takes on everybody waiting to watch, as long as there is room for them.
+ * They start out with a keyframe.
+ */
+static void
+acceptViewers(struct broadcast *broadcast)
+{
+	int fd, yes = 1;
+
+	while ((fd = accept(broadcast->listenFd, NULL, NULL)) >= 0) {
+		if (broadcast->viewerCount == MAX_VIEWERS) {
+			close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		/* Frames are small, and should go out as soon as they are
+		 * drawn. */
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		struct viewer *viewer =
+			&broadcast->viewers[broadcast->viewerCount++];
+		viewer->fd = fd;
+		viewer->pos = broadcast->head;
+		viewer->keyframe = 1;
+		viewer->keySent = 0;
+	}
+}
+
+/*
+ * Fills in fds, which has room for BROADCAST_FDS, with what to wait for while
+ * nothing new is being drawn: somebody wanting to watch, or a viewer being
+ * ready for what it hasn't been sent yet. Returns how many were filled in.
+ * When any of them are ready, broadcastFrame() sees to them.
+ */
+int
+broadcastFds(const struct broadcast *broadcast, struct pollfd *fds)
+{
+	int count = 0;
+
+	fds[count].fd = broadcast->listenFd;
+	fds[count].events = POLLIN;
+	fds[count].revents = 0;
+	count++;
+	for (int i = 0; i < broadcast->viewerCount; i++) {
+		const struct viewer *viewer = &broadcast->viewers[i];
+		if (viewer->keyframe || viewer->pos != broadcast->head) {
+			fds[count].fd = viewer->fd;
+			fds[count].events = POLLOUT;
+			fds[count].revents = 0;
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+ * Sends everybody watching what they haven't had yet, up to the end of the
+ * frame just written. Called after each frame, and whenever what
+ * broadcastFds() filled in is ready.
+ */
+void
+broadcastFrame(struct broadcast *broadcast)
+{
+	const unsigned long long head = broadcast->head;
+	int stale = 0;
+
+	acceptViewers(broadcast);
+
+	/* A viewer the ring has moved on from starts over with a keyframe.
+	 * One that was already part way through one has to start over too,
+	 * if a new one is drawn. */
+	for (int i = 0; i < broadcast->viewerCount; i++) {
+		struct viewer *viewer = &broadcast->viewers[i];
+		if (head - viewer->pos > BROADCAST_RING_SIZE) {
+			viewer->keyframe = 1;
+			viewer->keySent = 0;
+			viewer->pos = head;
+		}
+		if (viewer->keyframe && viewer->keySent == 0
+				&& broadcast->keyframeAt != head) {
+			stale = 1;
+		}
+	}
+	if (stale) {
+		broadcast->keyframeLen = broadcast->drawKeyframe(
+				broadcast->keyframe, broadcast->keyframeSize);
+		broadcast->keyframeAt = head;
+		for (int i = 0; i < broadcast->viewerCount; i++) {
+			struct viewer *viewer = &broadcast->viewers[i];
+			if (viewer->keyframe) {
+				viewer->keySent = 0;
+				viewer->pos = head;
+			}
+		}
+	}
+
+	for (int i = 0; i < broadcast->viewerCount; i++) {
+		if (sendViewer(broadcast, &broadcast->viewers[i]) != 0) {
+			dropViewer(broadcast, i--);
+		}
+	}
+}
+
+/*
+ * Copies len bytes of output from buf into the ring.
+ */
+void
+broadcastOutput(struct broadcast *broadcast, const char *buf, size_t len)
+{
+	/* Only the end of something bigger than the ring is kept. */
+	if (len > BROADCAST_RING_SIZE) {
+		broadcast->head += len - BROADCAST_RING_SIZE;
+		buf += len - BROADCAST_RING_SIZE;
+		len = BROADCAST_RING_SIZE;
+	}
+	const size_t start = broadcast->head % BROADCAST_RING_SIZE;
+	const size_t first = len < BROADCAST_RING_SIZE - start ? len
+		: BROADCAST_RING_SIZE - start;
+	memcpy(broadcast->ring + start, buf, first);
+	memcpy(broadcast->ring, buf + first, len - first);
+	broadcast->head += len;
+}
+
+/*
+ * Stops sending to viewer i, who has gone away.
+ */
+static void
+dropViewer(struct broadcast *broadcast, int i)
+{
+	close(broadcast->viewers[i].fd);
+	broadcast->viewers[i] = broadcast->viewers[--broadcast->viewerCount];
+}
+
+/*
+ * Sends viewer as much as it will take, without waiting, of the rest of its
+ * keyframe and the output after it: all in one call, straight from where it
+ * is kept. Returns 0 on success, or -1 if the viewer has gone away.
+ */
+static int
+sendViewer(struct broadcast *broadcast, struct viewer *viewer)
+{
+	struct iovec parts[3];
+	int count = 0;
+
+	if (viewer->keyframe) {
+		parts[count].iov_base = broadcast->keyframe + viewer->keySent;
+		parts[count].iov_len = broadcast->keyframeLen
+			- viewer->keySent;
+		count++;
+	}
+	/* The output since pos might wrap around the end of the ring. */
+	const size_t start = viewer->pos % BROADCAST_RING_SIZE;
+	const size_t len = broadcast->head - viewer->pos;
+	const size_t first = len < BROADCAST_RING_SIZE - start ? len
+		: BROADCAST_RING_SIZE - start;
+	parts[count].iov_base = broadcast->ring + start;
+	parts[count].iov_len = first;
+	count++;
+	parts[count].iov_base = broadcast->ring;
+	parts[count].iov_len = len - first;
+	count++;
+
+	ssize_t sent = writev(viewer->fd, parts, count);
+	if (sent < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK
+			|| errno == EINTR ? 0 : -1;
+	}
+	if (viewer->keyframe) {
+		const size_t left = broadcast->keyframeLen - viewer->keySent;
+		if ((size_t)sent < left) {
+			viewer->keySent += sent;
+			return 0;
+		}
+		sent -= left;
+		viewer->keyframe = 0;
+	}
+	viewer->pos += sent;
+	return 0;
+}
+
+/*
+ * Starts taking viewers on port of the IPv4 address given in dotted form, or
+ * of the loopback address if address is NULL, so that nobody else can watch
+ * unless asked. Whatever is written with broadcastOutput() is broadcast.
+ * Keyframes of up to keyframeSize bytes are drawn with drawKeyframe. Returns 0
+ * on success, or -1 with errno set if the address isn't one, the port can't
+ * be listened on, or there isn't enough memory.
+ */
+int
+startBroadcast(struct broadcast *broadcast, const char *address, int port,
+		size_t keyframeSize, keyframeFunc drawKeyframe)
+{
+	struct sockaddr_in socketAddress;
+	int yes = 1;
+
+	memset(&socketAddress, 0, sizeof(socketAddress));
+	socketAddress.sin_family = AF_INET;
+	socketAddress.sin_port = htons((unsigned short)port);
+	if (address == NULL) {
+		socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	} else if (inet_pton(AF_INET, address,
+			&socketAddress.sin_addr) != 1) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	broadcast->ring = malloc(BROADCAST_RING_SIZE);
+	broadcast->keyframe = malloc(keyframeSize);
+	if (broadcast->ring == NULL || broadcast->keyframe == NULL) {
+		free(broadcast->ring);
+		free(broadcast->keyframe);
+		errno = ENOMEM;
+		return -1;
+	}
+	broadcast->head = 0;
+	broadcast->keyframeSize = keyframeSize;
+	broadcast->keyframeLen = 0;
+	/* No keyframe has been drawn yet, so it can't be from here. */
+	broadcast->keyframeAt = (unsigned long long)-1;
+	broadcast->drawKeyframe = drawKeyframe;
+	broadcast->viewerCount = 0;
+
+	broadcast->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (broadcast->listenFd < 0
+			|| setsockopt(broadcast->listenFd, SOL_SOCKET,
+				SO_REUSEADDR, &yes, sizeof(yes)) != 0
+			|| bind(broadcast->listenFd,
+				(struct sockaddr *)&socketAddress,
+				sizeof(socketAddress)) != 0
+			|| listen(broadcast->listenFd, MAX_VIEWERS) != 0) {
+		const int saved = errno;
+		if (broadcast->listenFd >= 0) {
+			close(broadcast->listenFd);
+		}
+		free(broadcast->ring);
+		free(broadcast->keyframe);
+		errno = saved;
+		return -1;
+	}
+	fcntl(broadcast->listenFd, F_SETFL, O_NONBLOCK);
+
+	/* A viewer that goes away shows up as an error from writev(), rather
+	 * than a signal that would end the game. */
+	signal(SIGPIPE, SIG_IGN);
+	return 0;
+}
+
+/*
+ * Sends the viewers what is left, as far as they will take it right away, and
+ * stops broadcasting.
+ */
+void
+stopBroadcast(struct broadcast *broadcast)
+{
+	broadcastFrame(broadcast);
+	for (int i = 0; i < broadcast->viewerCount; i++) {
+		close(broadcast->viewers[i].fd);
+	}
+	close(broadcast->listenFd);
+	free(broadcast->ring);
+	free(broadcast->keyframe);
+}
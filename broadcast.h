@@ -0,0 +1,101 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Sending what is drawn on the terminal to people watching over the network.
+ * Everything written to the terminal is copied once into a ring buffer, and
+ * at the end of each frame, each viewer is sent what it hasn't had yet
+ * straight out of the ring. A viewer that falls so far behind that the ring
+ * has moved on without it (or has only just connected) is sent a keyframe
+ * instead: the whole screen, drawn from scratch, followed by the frames after
+ * it. Viewers are never waited for.
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <poll.h>
+#include <stddef.h>
+
+/*
+ * The most viewers that can watch at once.
+ */
+#define MAX_VIEWERS 64
+
+/*
+ * The most file descriptors broadcastFds() fills in: the socket viewers connect
+ * to, and one for each viewer.
+ */
+#define BROADCAST_FDS (MAX_VIEWERS + 1)
+
+/*
+ * Size of the ring buffer, in bytes. It has to be a power of two.
+ */
+#define BROADCAST_RING_SIZE (1 << 18)
+
+/*
+ * Someone watching. pos is how much of the output the viewer has been sent,
+ * counting from the start of the broadcast. If keyframe is set, it is being
+ * sent the keyframe, of which it has had keySent bytes, before anything from
+ * pos on.
+ */
+struct viewer {
+	int fd;
+	unsigned long long pos;
+	int keyframe;
+	size_t keySent;
+};
+
+/*
+ * Writes a keyframe into buf, which is size bytes long, and returns its
+ * length. It has to leave a viewer's terminal just as the output leaves the
+ * player's at the end of a frame.
+ */
+typedef size_t (*keyframeFunc)(char *buf, size_t size);
+
+struct broadcast {
+	/* The socket viewers connect to. */
+	int listenFd;
+
+	/* The last BROADCAST_RING_SIZE bytes of output. head is how many
+	 * bytes have been written in all, so byte n of the output is at
+	 * ring[n % BROADCAST_RING_SIZE] until it is written over. */
+	char *ring;
+	unsigned long long head;
+
+	/* The last keyframe drawn, which is keyframeLen bytes long, and the
+	 * position in the output it was drawn at. */
+	char *keyframe;
+	size_t keyframeSize;
+	size_t keyframeLen;
+	unsigned long long keyframeAt;
+	keyframeFunc drawKeyframe;
+
+	struct viewer viewers[MAX_VIEWERS];
+	int viewerCount;
+};
+
+int broadcastFds(const struct broadcast *broadcast, struct pollfd *fds);
+void broadcastFrame(struct broadcast *broadcast);
+void broadcastOutput(struct broadcast *broadcast, const char *buf,
+		size_t len);
+int startBroadcast(struct broadcast *broadcast, const char *address,
+		int port, size_t keyframeSize, keyframeFunc drawKeyframe);
+void stopBroadcast(struct broadcast *broadcast);
+
+#endif /* BROADCAST_H */
@@ -0,0 +1,1042 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "instrument.h"
+#include "levels.h"
+
+/*
+ * The amount of lives the player starts out with at the beginning of the game.
+ */
+const int STARTING_LIVES = 5;
+
+/*
+ * The most frames that will be simulated in a row without drawing the screen
+ * in between.
+ */
+const unsigned long MAX_CATCHUP_FRAMES = 40;
+
+/*
+ * The longest message that can be shown.
+ */
+#define MESSAGE_SIZE 256
+
+static int addBall(struct game *game, int fx, int fy, int dx, int dy);
+static void advanceBalls(struct balls *balls);
+static int ballSpeed(int framesPerTile);
+static int clamp(int value, int low, int high);
+static int countBits(uint64_t bits);
+static int crossTiles(struct game *game, int i, const struct paddle *paddle);
+static void drawBalls(struct game *game);
+static int highestBit(uint64_t bits);
+static size_t levelSize(const struct game *game);
+static void newLevel(struct game *game, int maxBlockY);
+static void newLife(struct game *game, int maxBlockY);
+static void placeBlock(struct game *game, int k, int y, enum tile t);
+static void splitBall(struct game *game, int i);
+static void startLevel(struct game *game);
+static long long untilCrossing(int position, int tile, int velocity);
+
+/*
+ * Puts a new ball into play at (fx, fy), moving at (dx, dy), all in fixed
+ * point. Returns the number of the new ball, or -1 if there are already
+ * MAX_BALLS balls in play.
+ */
+static int
+addBall(struct game *game, int fx, int fy, int dx, int dy)
+{
+	struct balls *balls = &game->balls;
+	const int i = balls->count;
+
+	if (i == MAX_BALLS) {
+		return -1;
+	}
+	balls->count++;
+	balls->x[i] = fx / FIXED_ONE;
+	balls->y[i] = fy / FIXED_ONE;
+	balls->fx[i] = fx;
+	balls->fy[i] = fy;
+	balls->dx[i] = dx;
+	balls->dy[i] = dy;
+	balls->crossed[i] = 0;
+	return i;
+}
+
+/*
+ * Moves every ball along by its velocity, as if there was nothing in its way,
+ * and notes which ones crossed into a new tile. This is the same few sums for
+ * every ball with no branches, so the compiler can work on several at once.
+ */
+static void
+advanceBalls(struct balls *balls)
+{
+	const int count = balls->count;
+	const int *restrict x = balls->x, *restrict y = balls->y;
+	int *restrict fx = balls->fx, *restrict fy = balls->fy;
+	const int *restrict dx = balls->dx, *restrict dy = balls->dy;
+	uint8_t *restrict crossed = balls->crossed;
+
+	for (int i = 0; i < count; i++) {
+		const int endX = fx[i] + dx[i], endY = fy[i] + dy[i];
+		const int left = x[i] * FIXED_ONE, top = y[i] * FIXED_ONE;
+
+		fx[i] = endX;
+		fy[i] = endY;
+		crossed[i] = (endX < left) | (endX >= left + FIXED_ONE)
+			| (endY < top) | (endY >= top + FIXED_ONE);
+	}
+}
+
+/*
+ * Returns the speed, in fixed point, of a ball that takes framesPerTile frames
+ * to cross a tile. framesPerTile must be more than 1.
+ */
+static int
+ballSpeed(int framesPerTile)
+{
+	return FIXED_ONE / framesPerTile;
+}
+
+/*
+ * Returns how many blocks are left in row y of the board.
+ */
+int
+blocksInRow(const struct game *game, int y)
+{
+	const uint64_t *row = &game->blocks[(size_t)y * game->rowWords];
+	int blocks = 0;
+
+	for (int i = 0; i < game->rowWords; i++) {
+		blocks += countBits(row[i]);
+	}
+	return blocks;
+}
+
+/*
+ * Returns how many blocks are left on the board.
+ */
+int
+blocksLeft(const struct game *game)
+{
+	return game->blockCount;
+}
+
+/*
+ * Moves every ball along for a frame, and takes out the ones that reach the
+ * bottom of the play field. Returns how many balls are left in play.
+ */
+int
+checkBalls(struct game *game, const struct paddle *paddle)
+{
+	struct balls *balls = &game->balls;
+	const int count = balls->count;
+	int *x = balls->x, *y = balls->y;
+
+	/* First, every ball moves as if there was nothing in its way. */
+	advanceBalls(balls);
+
+	/* Most balls stay in their tiles. The few that don't find out what
+	 * they ran into one at a time, in order, so that when two balls reach
+	 * the same block on the same frame, the first one gets it. A ball that
+	 * is lost is moved off the bottom of the board. */
+	for (int i = 0; i < count; i++) {
+		if (balls->crossed[i] && !crossTiles(game, i, paddle)) {
+			updateTile(game, x[i], y[i]);
+			y[i] = game->height;
+		}
+	}
+
+	/* The rest of the balls, including any that were split off along the
+	 * way, stay in play in the same order. */
+	int kept = 0;
+	for (int i = 0; i < balls->count; i++) {
+		if (y[i] == game->height) {
+			continue;
+		}
+		x[kept] = x[i];
+		y[kept] = y[i];
+		balls->fx[kept] = balls->fx[i];
+		balls->fy[kept] = balls->fy[i];
+		balls->dx[kept] = balls->dx[i];
+		balls->dy[kept] = balls->dy[i];
+		kept++;
+	}
+	balls->count = kept;
+	return kept;
+}
+
+/*
+ * Returns a checksum (32-bit FNV-1a) of everything on the board, for telling
+ * quickly whether two games ended up in the same place.
+ */
+uint32_t
+checksumBoard(const struct game *game)
+{
+	const size_t size = (size_t)game->width * game->height;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ game->board[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Returns value, kept from low to high.
+ */
+static int
+clamp(int value, int low, int high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+/*
+ * Returns the number of bits set in bits.
+ */
+static int
+countBits(uint64_t bits)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(bits);
+#else
+	int count = 0;
+	for (; bits != 0; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+#endif
+}
+
+/*
+ * Works out what ball i ran into on its way to where it is now, having crossed
+ * into at least one new tile this frame. Every tile the ball crossed into is
+ * checked in the order it got there, and bouncing off it (or moving into it
+ * with moveBall) is handled. Returns 0 if the ball reached the bottom of the
+ * play field, otherwise returns 1.
+ */
+static int
+crossTiles(struct game *game, int i, const struct paddle *paddle)
+{
+	struct balls *balls = &game->balls;
+	const int startX = balls->x[i], startY = balls->y[i];
+	/* Where the ball would be at the end of the frame if it didn't run
+	 * into anything, which is where advanceBalls() put it. */
+	const int endX = balls->fx[i], endY = balls->fy[i];
+	const int dx = balls->dx[i], dy = balls->dy[i];
+
+	/* The ball moves less than a tile each way in a frame, so it crosses
+	 * into at most one new column and one new row. */
+	int crossX = dx > 0 ? endX >= (startX + 1) * FIXED_ONE
+		: endX < startX * FIXED_ONE;
+	int crossY = dy > 0 ? endY >= (startY + 1) * FIXED_ONE
+		: endY < startY * FIXED_ONE;
+
+	/* If it crosses both, whichever edge it reaches first goes first:
+	 * comparing the distances to them, scaled by the other axis's speed,
+	 * compares the times without dividing. */
+	int xFirst = 1;
+	if (crossX && crossY) {
+		long long toX = untilCrossing(endX - dx, startX, dx);
+		long long toY = untilCrossing(endY - dy, startY, dy);
+		xFirst = toX * abs(dy) <= toY * abs(dx);
+	}
+
+	/* Once the ball bounces, it stays in its tile for the rest of the
+	 * frame. */
+	int bounced = 0;
+	for (int pass = 0; pass < 2 && !bounced; pass++) {
+		const int alongX = (pass == 0) == xFirst;
+		if (alongX ? !crossX : !crossY) {
+			continue;
+		}
+		const int x = balls->x[i] + (alongX ? (dx > 0 ? 1 : -1) : 0);
+		const int y = balls->y[i] + (alongX ? 0 : (dy > 0 ? 1 : -1));
+
+		/* The ball has hit the bottom of the game field. */
+		if (y >= game->height) {
+			return 0;
+		}
+
+		/* What the ball is about to run into, if anything. */
+		const int block = isBlock(game, x, y);
+		const int hitPaddle = y == paddle->y && x >= paddle->x
+			&& x < paddle->x + paddle->len;
+
+		/* if the incoming tile is valid and empty, move there */
+		if (x >= 0 && x < game->width && y >= 0 && !block
+				&& !hitPaddle) {
+			moveBall(game, i, x, y);
+			continue;
+		}
+		/* otherwise, bounce! */
+		bounced = 1;
+		/* bounce off the side walls */
+		if (x < 0 || x >= game->width) {
+			balls->dx[i] = -dx;
+		/* bounce off the ceiling */
+		} else if (y < 0) {
+			balls->dy[i] = -dy;
+		/* bounce off paddle */
+		} else if (hitPaddle) {
+			/* If dy is not inverted here, then the ball will just
+			 * roll about on the paddle for a little bit, which is
+			 * actually kindof fun. Try it out if you're bored. */
+			const int yDirection = dy > 0 ? -1 : 1;
+			/* randomize bounce and velocity */
+			int xDirection = dx > 0 ? 1 : -1;
+			if (rngRange(&game->rng, 2) == 0)
+				xDirection = -xDirection;
+			balls->dx[i] = xDirection * ballSpeed(
+					rngRange(&game->rng, 8) + 5);
+			balls->dy[i] = yDirection * ballSpeed(
+					rngRange(&game->rng, 8) + 5);
+		/* bounce off (and destroy) block */
+		} else {
+			destroyBlock(game, x, y);
+			if (rngRange(&game->rng, 2) == 0)
+				balls->dx[i] = -dx;
+			if (rngRange(&game->rng, 2) == 0)
+				balls->dy[i] = -dy;
+			if (game->multiball && rngRange(&game->rng,
+						MULTIBALL_CHANCE) == 0) {
+				splitBall(game, i);
+			}
+		}
+	}
+
+	if (bounced) {
+		/* Whatever is left of the frame's movement is lost, and the
+		 * ball ends up just inside its tile, on the side it was heading
+		 * for. */
+		balls->fx[i] = clamp(endX, balls->x[i] * FIXED_ONE,
+				(balls->x[i] + 1) * FIXED_ONE - 1);
+		balls->fy[i] = clamp(endY, balls->y[i] * FIXED_ONE,
+				(balls->y[i] + 1) * FIXED_ONE - 1);
+	}
+
+	/* Indicates that the ball did not hit the bottom of the play field. */
+	return 1;
+}
+
+/*
+ * Destroys the block at (x, y) on the board, and replaces it with EMPTY.
+ * Intended to be called when the ball bounces into a block.
+ */
+void
+destroyBlock(struct game *game, int x, int y)
+{
+	/* Blocks are generated in groups of two, which means that if one block
+	 * tile is hit, then one of its neighbors is also going to be
+	 * destroyed. Because of the way the board is generated, the first tile
+	 * in a block is always odd. We can use this fact to determine which
+	 * tile of the block the ball hit: the first or the second. If the x
+	 * value is odd, then the ball hit the first; if it is even, the the
+	 * ball hit the second. This is interpreted as an offset to the x value
+	 * which, when added to the x value, will give us the coordinate of the
+	 * second tile in the block. */
+	int offset = (x % 2 == 1) ? 1 : -1;
+	const int k = (x - BLOCK_X) / 2;
+	TILE(game, x, y) = EMPTY;
+	updateTile(game, x, y);
+	TILE(game, x + offset, y) = EMPTY;
+	updateTile(game, x + offset, y);
+	/* Remove the block from its row, and the row from the board if that
+	 * was the last block in it. */
+	game->blocks[(size_t)y * game->rowWords + k / 64] &=
+		~((uint64_t)1 << k % 64);
+	if (blocksInRow(game, y) == 0) {
+		game->blockRows[y / 64] &= ~((uint64_t)1 << y % 64);
+	}
+	game->blockCount--;
+	game->blocksDestroyed++;
+	/* Give the player points for destroying a block. */
+	game->score += 10;
+	game->renderer->score(game->renderer, game->score);
+}
+
+/*
+ * Draws every ball over whatever is under it.
+ */
+static void
+drawBalls(struct game *game)
+{
+	for (int i = 0; i < game->balls.count; i++) {
+		game->renderer->tile(game->renderer, game->balls.x[i],
+				game->balls.y[i], BALL);
+	}
+}
+
+/*
+ * Frees everything that was allocated for game.
+ */
+void
+freeGame(struct game *game)
+{
+	arenaFree(&game->arena);
+}
+
+/*
+ * Generates a starting game board, with the paddle where it is now. The board
+ * starts out empty, the way startLevel() leaves it.
+ */
+void
+generateBoard(struct game *game, const int level, const int maxBlockY)
+{
+	const struct paddle *paddle = game->paddle;
+
+	/* Create the paddle. The balls aren't part of the board: they are
+	 * drawn over it. */
+	for (int i = 0; i < paddle->len; i++) {
+		TILE(game, paddle->x + i, paddle->y) = PADDLE;
+	}
+
+	/* A level from a pack is laid out the way it was made, as much of it
+	 * as fits above maxBlockY. */
+	if (game->levels != NULL) {
+		struct level layout;
+		findLevel(game->levels, level, &layout);
+		const int columns = min(layout.columns, game->columns);
+		const int rows = min(layout.rows, maxBlockY);
+		for (int j = 0; j < rows; j++) {
+			for (int k = 0; k < columns; k++) {
+				const int block = levelBlock(&layout, k, j);
+				if (block != 0) {
+					placeBlock(game, k, j,
+							RED_BLOCK + block - 1);
+				}
+			}
+		}
+		return;
+	}
+
+	/* Fills in a section of the board with breakable blocks. */
+	for (int k = 0; k < game->columns; k++) {
+		/* maxBlockY is the lowest distance the blocks can be
+		 * generated. */
+		for (int j = 3; j < maxBlockY; j++) {
+			placeBlock(game, k, j,
+					RED_BLOCK + rngRange(&game->rng, 3));
+		}
+	}
+}
+
+/*
+ * Returns the index of the highest bit set in bits, which must not be 0.
+ */
+static int
+highestBit(uint64_t bits)
+{
+#ifdef __GNUC__
+	return 63 - __builtin_clzll(bits);
+#else
+	int bit = 0;
+	while (bits >>= 1) {
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/*
+ * Sets up a new game on a width by height board, starting at the given level,
+ * shown through renderer and controlled through input. Games set up with the
+ * same seed and played with the same input turn out the same. Returns 0 on
+ * success, or -1 with errno set if the rules or the level are out of range or
+ * there isn't enough memory for the board. The game must be freed with
+ * freeGame().
+ */
+int
+initGame(struct game *game, const struct rules *rules, int level,
+		uint64_t seed, struct renderer *renderer, struct input *input)
+{
+	if (rules->width < MIN_WIDTH || rules->width > MAX_WIDTH
+			|| rules->height < MIN_HEIGHT
+			|| rules->height > MAX_HEIGHT
+			|| rules->balls < 1 || rules->balls > MAX_BALLS
+			|| level < 1 || level > MAX_LEVEL) {
+		errno = EINVAL;
+		return -1;
+	}
+	game->width = rules->width;
+	game->height = rules->height;
+	game->columns = (game->width - 2 * BLOCK_X) / 2;
+	game->startBalls = rules->balls;
+	game->multiball = rules->multiball;
+	game->levels = rules->levels;
+	game->rowWords = (game->columns + 63) / 64;
+
+	/* Every level needs the same amount of room, so the arena is sized
+	 * once, up front. */
+	if (arenaInit(&game->arena, levelSize(game)) != 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+	startLevel(game);
+
+	game->level = level;
+	game->score = 0;
+	game->lives = STARTING_LIVES;
+	game->frames = 0;
+	game->lifeFrames = 0;
+	game->blocksDestroyed = 0;
+	game->resumed = 0;
+	game->seed = seed;
+	rngSeed(&game->rng, seed);
+	game->renderer = renderer;
+	game->input = input;
+	return 0;
+}
+
+/*
+ * Returns whether there is a block at (x, y) on the board. Coordinates off the
+ * board don't have blocks.
+ */
+int
+isBlock(const struct game *game, int x, int y)
+{
+	int k;
+
+	if (x < BLOCK_X || y < 0 || y >= game->height) {
+		return 0;
+	}
+	if ((k = (x - BLOCK_X) / 2) >= game->columns) {
+		return 0;
+	}
+	return (game->blocks[(size_t)y * game->rowWords + k / 64] >> k % 64)
+		& 1;
+}
+
+/*
+ * Returns how much room the arena of game needs for a level.
+ */
+static size_t
+levelSize(const struct game *game)
+{
+	return arenaSize((size_t)game->width * game->height)
+		+ arenaSize((size_t)game->height * game->rowWords
+				* sizeof(*game->blocks))
+		+ arenaSize((size_t)(game->height + 63) / 64
+				* sizeof(*game->blockRows))
+		+ 6 * arenaSize(MAX_BALLS * sizeof(int))
+		+ arenaSize(MAX_BALLS * sizeof(*game->balls.crossed))
+		+ arenaSize(sizeof(*game->paddle));
+}
+
+/*
+ * Returns the y-coordinate of the lowest row that still has blocks in it, or
+ * -1 if there are no blocks left.
+ */
+int
+lowestBlock(const struct game *game)
+{
+	for (int i = (game->height - 1) / 64; i >= 0; i--) {
+		if (game->blockRows[i] != 0) {
+			return i * 64 + highestBit(game->blockRows[i]);
+		}
+	}
+	return -1;
+}
+
+/*
+ * Returns the maximum of two values.
+ */
+int
+max(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/*
+ * Returns the minimum of two values.
+ */
+int
+min(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+/*
+ * Moves ball i to (x, y) on the board.
+ */
+void
+moveBall(struct game *game, int i, int x, int y)
+{
+	/* Whatever the ball was covering up shows through again. */
+	updateTile(game, game->balls.x[i], game->balls.y[i]);
+	game->balls.x[i] = x;
+	game->balls.y[i] = y;
+	game->renderer->tile(game->renderer, x, y, BALL);
+}
+
+/*
+ * Move the paddle according to its direction.
+ */
+void
+movePaddle(struct game *game, struct paddle *paddle)
+{
+	/* The x-coordinate (in board) of which tiles are going to be changed.
+	 */
+
+	int newPaddleX, newEmptyX;
+
+	/* if paddle is moving left */
+	if ((*paddle).direction < 0 && (*paddle).x + (*paddle).direction >= 0) {
+		for (int i = 0; i > (*paddle).direction; i--) {
+			newPaddleX = (*paddle).x - 1;
+			newEmptyX = (*paddle).x + (*paddle).len - 1;
+			TILE(game, newPaddleX, (*paddle).y) = PADDLE;
+			TILE(game, newEmptyX, (*paddle).y) = EMPTY;
+			updateTile(game, newPaddleX, (*paddle).y);
+			updateTile(game, newEmptyX, (*paddle).y);
+			(*paddle).x--;
+		}
+	/* if paddle is moving right */
+	} else if ((*paddle).direction > 0
+			&& (*paddle).x + (*paddle).len + (*paddle).direction
+				<= game->width) {
+		for (int i = 0; i < (*paddle).direction; i++) {
+			newPaddleX = (*paddle).x + (*paddle).len;
+			newEmptyX = (*paddle).x;
+			TILE(game, newPaddleX, (*paddle).y) = PADDLE;
+			TILE(game, newEmptyX, (*paddle).y) = EMPTY;
+			updateTile(game, newPaddleX, (*paddle).y);
+			updateTile(game, newEmptyX, (*paddle).y);
+			(*paddle).x++;
+		}
+	}
+}
+
+/*
+ * Sets up the level game is on, with blocks down to maxBlockY: throws out the
+ * last one, puts a new paddle on a new board, and hands out some lives.
+ */
+static void
+newLevel(struct game *game, int maxBlockY)
+{
+	const int level = game->level;
+
+	/* Everything from the last level is thrown out. */
+	startLevel(game);
+
+	struct paddle *paddle = game->paddle;
+	/* The paddle gets shorter as the game goes on. */
+	paddle->len = max(20 - (2 * (level / 3)), 10);
+	paddle->x = (game->width - paddle->len) / 2;
+	paddle->y = (11 * game->height) / 12;
+	paddle->direction = 0;
+	paddle->lastDirection = 0;
+	paddle->velocity = 4;
+
+	/* Give the player some extra lives every once in a while, to be nice.
+	 */
+	if (level <= 1) {
+		/* But not on the first level, since the player starts out with
+		 * some. */
+		;
+	} else if (level < 10) {
+		game->lives += 2;
+	} else if (level < 20) {
+		game->lives++;
+	/* Gives out a life every two levels now. */
+	} else if (level % 2 == 0 && level < 40) {
+		game->lives++;
+	/* And now every four, until level 60, then the handouts end. */
+	} else if (level % 4 == 0 && level < 60) {
+		game->lives++;
+	}
+
+	/* Generates a new board for this level. */
+	generateBoard(game, level, maxBlockY);
+}
+
+/*
+ * Sets up the start of a life on a level with blocks down to maxBlockY: new
+ * balls, and the paddle back in the middle.
+ */
+static void
+newLife(struct game *game, int maxBlockY)
+{
+	struct paddle *paddle = game->paddle;
+
+	game->lifeFrames = 0;
+
+	/* The balls reset at the start of each life, all starting out from
+	 * the middle of the board, heading up. */
+	game->balls.count = 0;
+	for (int i = 0; i < game->startBalls; i++) {
+		int dx = ballSpeed(rngRange(&game->rng, 10) + 6);
+		int dy = -ballSpeed(rngRange(&game->rng, 10) + 6);
+		if (rngRange(&game->rng, 2) != 0)
+			dx = -dx;
+		addBall(game, game->width / 2 * FIXED_ONE + FIXED_ONE / 2,
+				(maxBlockY + paddle->y) / 2 * FIXED_ONE
+				+ FIXED_ONE / 2, dx, dy);
+	}
+
+	/* The paddle recenters itself and resets at the start of each life.
+	 */
+	paddle->x = (game->width - paddle->len) / 2;
+	paddle->direction = 0;
+	paddle->lastDirection = 0;
+	/* Update paddle tile graphics. */
+	for (int i = 0; i < game->width; i++) {
+		TILE(game, i, paddle->y) = EMPTY;
+	}
+	for (int i = 0; i < paddle->len; i++) {
+		TILE(game, paddle->x + i, paddle->y) = PADDLE;
+	}
+}
+
+/*
+ * Returns the first frame after frame on which the ball or the paddle will
+ * move, or 0 if neither will move until something else changes.
+ */
+unsigned int
+nextMove(const struct balls *balls, const struct paddle *paddle,
+		unsigned int frame, int isPaused)
+{
+	unsigned int next;
+	/* No ball takes longer than this to cross a tile. */
+	int soonest = FIXED_ONE;
+
+	if (isPaused) {
+		return 0;
+	}
+
+	/* The balls move every frame, but they only change tiles when they
+	 * cross into the next one on either axis. The paddle moves on frames
+	 * that are multiples of its velocity. */
+	for (int i = 0; i < balls->count; i++) {
+		const int speedX = abs(balls->dx[i]), speedY = abs(balls->dy[i]);
+		const long long toX = untilCrossing(balls->fx[i], balls->x[i],
+				balls->dx[i]);
+		const long long toY = untilCrossing(balls->fy[i], balls->y[i],
+				balls->dy[i]);
+		soonest = min(soonest, min((toX + speedX - 1) / speedX,
+				(toY + speedY - 1) / speedY));
+	}
+	next = frame + soonest;
+	if (paddle->direction != 0) {
+		next = min(next,
+			(frame / paddle->velocity + 1) * paddle->velocity);
+	}
+	return next;
+}
+
+/*
+ * Puts a block of kind t at block k of row y.
+ */
+static void
+placeBlock(struct game *game, int k, int y, enum tile t)
+{
+	const int x = BLOCK_X + 2 * k;
+
+	game->blocks[(size_t)y * game->rowWords + k / 64] |=
+		(uint64_t)1 << k % 64;
+	game->blockRows[y / 64] |= (uint64_t)1 << y % 64;
+	game->blockCount++;
+	TILE(game, x, y) = t;
+	TILE(game, x + 1, y) = t;
+}
+
+/*
+ * Plays a level of the game. Returns the amount of lives remaining at the
+ * completion of the level.
+ */
+int
+play(struct game *game)
+{
+	const int level = game->level;
+	struct renderer *renderer = game->renderer;
+	struct input *input = game->input;
+
+	/* The height of the blocks (how far down on the play field they
+	 * generate) increases as the levels progress, capping at five-sixths
+	 * of the height of the board. */
+	const int maxBlockY = (game->height / 3)
+		+ min(level / 2, game->height / 2);
+
+	/* A game resumed from a snapshot carries on with the level it was
+	 * on. */
+	if (!game->resumed) {
+		newLevel(game, maxBlockY);
+	}
+	struct paddle *paddle = game->paddle;
+
+	/* A message is printed at the screen at the start of each level/life.
+	 * It is slightly different if you are not on level 1. */
+	char *message;
+	if (level == 1) {
+		message =
+			"ASCII Breakout\n"
+			"by Sebastian LaVine\n"
+			"Press j and k to move the paddle\n"
+			"Level: %d\nLives remaining: %d\n"
+			"Press any key to continue";
+	} else {
+		message =
+			"Level: %d\nLives remaining: %d\n"
+			"Press any key to continue";
+	}
+
+	/* This is the life loop. In this loop, one life is played out. It can
+	 * loop many times within one call of play() (a level). */
+	while (game->lives > 0) {
+		/* when the game is paused, the ball freezes and
+		 * gameplay-related input is frozen. */
+		int isPaused = 0;
+
+		/* A resumed game carries on with the life it was on, too. */
+		if (game->resumed) {
+			game->resumed = 0;
+		} else {
+			newLife(game, maxBlockY);
+		}
+
+		/* Counts how many frames of gameplay have taken place so far.
+		 * It is kept here while the frames are simulated, and in game
+		 * while waiting, for a snapshot to be taken. */
+		unsigned int frame = game->lifeFrames;
+
+		/* Draws initial graphics for the board. */
+		renderer->redraw(renderer, game);
+
+		showMessage(game, message, level, game->lives);
+		input->anykey(input);
+		/* Redraw initial graphics to make the message go away. */
+		renderer->redraw(renderer, game);
+
+		/* Time stood still while the message was up. */
+		input->resume(input, game->frames + 1);
+
+		/* Whether the ball is still in play. */
+		int alive = 1;
+
+		/* This is the main game loop. Input is interpreted, tiles
+		 * move, etc. Frames are simulated at a fixed rate no matter
+		 * how long drawing takes; if drawing falls behind, several
+		 * frames are simulated before the screen is drawn again. */
+		while (alive) {
+			/* Most frames don't move anything, so sleep until the
+			 * next one that does, or until there is input. When
+			 * the game is paused, nothing is going to move. */
+			unsigned int next = nextMove(&game->balls, paddle,
+					frame, isPaused);
+			game->lifeFrames = frame;
+			input->wait(input, next == 0 ? 0
+					: game->frames + (next - frame));
+
+			struct controls controls;
+			INSTRUMENT_START(inputStart);
+			input->read(input, &controls, game->frames + 1,
+					isPaused);
+			INSTRUMENT_END(PHASE_INPUT, inputStart);
+			if (controls.quit) {
+				return 0;
+			}
+			if (controls.redraw) {
+				renderer->redraw(renderer, game);
+			}
+			if (controls.togglePause) {
+				isPaused = !isPaused;
+				/* Don't catch up on the frames spent paused. */
+				if (!isPaused) {
+					input->resume(input, game->frames + 1);
+				}
+			}
+			/* The paddle continues to move even if there is no
+			 * input. */
+			if (controls.direction != 0) {
+				paddle->direction = controls.direction;
+				paddle->lastDirection = 0;
+			}
+
+			/* Simulate every frame that is due. If the game has
+			 * fallen too far behind, (for example, if it was
+			 * suspended) skip ahead instead of rushing to catch
+			 * up. */
+			unsigned long due = input->due(input);
+			if (due > game->frames + MAX_CATCHUP_FRAMES) {
+				due = game->frames + MAX_CATCHUP_FRAMES;
+				input->resume(input, due + 1);
+			}
+			INSTRUMENT_START(physicsStart);
+			while (game->frames < due) {
+				game->frames++;
+				frame++;
+
+				if (!isPaused && paddle->direction != 0
+						&& frame % paddle->velocity == 0) {
+					movePaddle(game, paddle);
+				}
+
+				if (!isPaused && checkBalls(game, paddle)
+						== 0) {
+					game->lives--;
+					alive = 0;
+					break;
+				}
+
+				/* If there are no blocks remaining, then the
+				 * player has won and moves on to the next
+				 * level. */
+				if (game->blockCount == 0) {
+					return game->lives;
+				}
+			}
+			INSTRUMENT_END(PHASE_PHYSICS, physicsStart);
+
+			/* Everything that changed since the last time is shown
+			 * at once. The balls go on top, in case something
+			 * else was drawn over one of them (another ball
+			 * leaving the same tile, or the paddle). */
+			if (alive) {
+				INSTRUMENT_START(renderStart);
+				drawBalls(game);
+				renderer->present(renderer);
+				INSTRUMENT_END(PHASE_RENDER, renderStart);
+				INSTRUMENT_FRAME();
+			}
+		}
+	}
+
+	return game->lives;
+}
+
+/*
+ * Plays through the levels until the player runs out of lives or quits.
+ */
+void
+playGame(struct game *game)
+{
+	struct input *input = game->input;
+
+	while (play(game) > 0) {
+		showMessage(game, "Level %d complete!\nPress any key to continue...",
+				game->level);
+		input->anykey(input);
+		game->level++;
+	}
+
+	/* When the program reaches this point, the player has ran out of
+	 * lives, and the game is over. */
+	showMessage(game,
+			"Game over!\nScore: %d\nLevel: %d\nPress any key to quit.",
+			game->score, game->level);
+	input->anykey(input);
+}
+
+/*
+ * Displays a printf(3)-formatted message, centered on the playfield.
+ */
+void
+showMessage(struct game *game, const char *fmt, ...)
+{
+	va_list ap;
+	char buffer[MESSAGE_SIZE];
+
+	va_start(ap, fmt);
+	vsnprintf(buffer, sizeof(buffer) / sizeof(*buffer), fmt, ap);
+	va_end(ap);
+
+	game->renderer->message(game->renderer, buffer);
+	game->renderer->present(game->renderer);
+}
+
+/*
+ * Splits ball i into three: two more balls go off from the middle of its tile,
+ * in random directions and at random speeds, as long as there is room for
+ * them.
+ */
+static void
+splitBall(struct game *game, int i)
+{
+	const int fx = game->balls.x[i] * FIXED_ONE + FIXED_ONE / 2;
+	const int fy = game->balls.y[i] * FIXED_ONE + FIXED_ONE / 2;
+
+	for (int k = 0; k < 2; k++) {
+		int dx = ballSpeed(rngRange(&game->rng, 8) + 5);
+		int dy = ballSpeed(rngRange(&game->rng, 8) + 5);
+		if (rngRange(&game->rng, 2) == 0)
+			dx = -dx;
+		if (rngRange(&game->rng, 2) == 0)
+			dy = -dy;
+		addBall(game, fx, fy, dx, dy);
+	}
+}
+
+/*
+ * Throws out the last level, and gives the next one an empty board with no
+ * blocks, a new paddle, and no balls.
+ */
+static void
+startLevel(struct game *game)
+{
+	const size_t area = (size_t)game->width * game->height;
+
+	/* The arena was sized for exactly this in initGame(), so none of this
+	 * can fail. */
+	arenaReset(&game->arena);
+	game->board = arenaAlloc(&game->arena, area);
+	game->blocks = arenaAlloc(&game->arena, (size_t)game->height
+			* game->rowWords * sizeof(*game->blocks));
+	game->blockRows = arenaAlloc(&game->arena,
+			(size_t)(game->height + 63) / 64
+			* sizeof(*game->blockRows));
+	game->balls.count = 0;
+	game->balls.x = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.y = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.fx = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.fy = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.dx = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.dy = arenaAlloc(&game->arena, MAX_BALLS * sizeof(int));
+	game->balls.crossed = arenaAlloc(&game->arena,
+			MAX_BALLS * sizeof(*game->balls.crossed));
+	game->paddle = arenaAlloc(&game->arena, sizeof(*game->paddle));
+	game->blockCount = 0;
+	/* The board starts out empty, since arenaAlloc() hands out zeroed
+	 * memory and EMPTY is 0. */
+}
+
+/*
+ * Redraws the tile at (x, y) on the board. No bounds-checking is done here.
+ */
+void
+updateTile(struct game *game, int x, int y)
+{
+	game->renderer->tile(game->renderer, x, y, TILE(game, x, y));
+}
+
+/*
+ * Returns how far, in fixed point, something at position in tile has to go at
+ * velocity to cross into the next tile.
+ */
+static long long
+untilCrossing(int position, int tile, int velocity)
+{
+	if (velocity > 0) {
+		return (long long)(tile + 1) * FIXED_ONE - position;
+	}
+	return position - (long long)tile * FIXED_ONE + 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The game itself: the board, the ball and the paddle, and the rules they
+ * follow. Nothing in here touches the terminal; the game is shown through a
+ * struct renderer and controlled through a struct input, so that it can be
+ * played in a terminal or simulated without one.
+ */
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "rng.h"
+
+/*
+ * The ball's position and velocity are kept in fixed point, in FIXED_ONEths of
+ * a tile, so that it can move smoothly at any speed.
+ */
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+/*
+ * The most balls that can be in play at once.
+ */
+#define MAX_BALLS 1024
+
+/*
+ * Store data about the balls in play, including location and velocity. Each
+ * field has an array of its own, with one entry for each ball, so that all of
+ * the balls can be moved in a single pass over each array.
+ */
+struct balls {
+	/* How many balls are in play. Balls 0 to count - 1 are. */
+	int count;
+
+	/* Coordinates of the tile each ball is in on the board. */
+	int *x;
+	int *y;
+
+	/* Where each ball is, in fixed point. Ball i is in tile (x[i], y[i])
+	 * when fx[i] is from x[i] * FIXED_ONE to (x[i] + 1) * FIXED_ONE - 1,
+	 * and likewise for fy[i]. */
+	int *fx;
+	int *fy;
+
+	/* How far each ball moves on each axis every frame, in fixed point.
+	 * This is always less than a tile. Negative dx is left, positive is
+	 * right; negative dy is up, positive is down. */
+	int *dx;
+	int *dy;
+
+	/* Whether each ball crossed into a new tile on the last frame. */
+	uint8_t *crossed;
+};
+
+/*
+ * Store data about the paddle, including location and direction.
+ */
+struct paddle {
+	/* Coordinates (in board) of the left-most character in the paddle. */
+	int x;
+	int y;
+
+	/* Length of the paddle. */
+	int len;
+
+	/* Direction the paddle is moving - negative for left, positive for
+	 * right. */
+	int direction;
+
+	/* The last direction the paddle was moving before it was frozen. */
+	int lastDirection;
+
+	/* used to control speed of the paddle */
+	int velocity;
+};
+
+/*
+ * What the player asked for during a single frame. All of the input waiting at
+ * the start of a frame is folded into one of these, so that keys which pile up
+ * (from auto-repeat, or mashing) don't keep acting on later frames.
+ */
+struct controls {
+	/* The direction of the last movement key pressed: negative for left,
+	 * positive for right, or 0 if none was. */
+	int direction;
+
+	/* Whether the game should be paused or unpaused. */
+	int togglePause;
+
+	/* Whether the game should be quit. */
+	int quit;
+
+	/* Whether the screen should be redrawn. */
+	int redraw;
+};
+
+/*
+ * Stores data about each tile (character space) on the board, namely, what it
+ * represents.
+ */
+enum tile {
+	EMPTY = 0,
+	BALL,
+	PADDLE,
+	RED_BLOCK,
+	BLUE_BLOCK,
+	GREEN_BLOCK,
+};
+
+/*
+ * Dimensions of the play field. The size of the board is picked when the game
+ * starts; these are the size it has unless asked otherwise, and the limits on
+ * what it can be.
+ */
+#define DEFAULT_WIDTH 60
+#define DEFAULT_HEIGHT 36
+#define MIN_WIDTH 56
+#define MIN_HEIGHT 18
+#define MAX_WIDTH 10000
+#define MAX_HEIGHT 10000
+
+/*
+ * The levels a game can start on. The upper limit leaves plenty of room for
+ * the level to go up as the game is played.
+ */
+#define MAX_LEVEL 1000000
+
+struct levelPack;
+
+/*
+ * The choices made before a game starts that change how it plays out, other
+ * than its seed and starting level. A game played again with the same rules,
+ * seed, level and input will turn out the same.
+ */
+struct rules {
+	/* Dimensions of the play field. */
+	int width;
+	int height;
+
+	/* How many balls are put into play at the start of each life. */
+	int balls;
+
+	/* Whether destroying a block can split the ball that hit it into
+	 * three. */
+	int multiball;
+
+	/* The level pack the boards come from (see levels.h), or NULL if
+	 * they are random. This isn't recorded, so a recording of a game
+	 * played from a pack has to be played back with the same pack. */
+	const struct levelPack *levels;
+};
+
+/*
+ * With multiball, the chance that destroying a block splits the ball is one in
+ * MULTIBALL_CHANCE.
+ */
+#define MULTIBALL_CHANCE 8
+
+/*
+ * Blocks are two tiles wide, and are laid out in columns from BLOCK_X to
+ * width - BLOCK_X, so that block k of a row covers x = BLOCK_X + 2k and the
+ * tile after it.
+ */
+#define BLOCK_X 3
+
+/*
+ * The tile at (x, y) on the board of game.
+ */
+#define TILE(game, x, y) ((game)->board[(size_t)(y) * (game)->width + (x)])
+
+struct game;
+
+/*
+ * Something that shows the game to the player. The game draws into it as
+ * things change, and calls present() when a frame is finished.
+ */
+struct renderer {
+	/* Draws tile t at (x, y) on the board. */
+	void (*tile)(struct renderer *r, int x, int y, enum tile t);
+
+	/* Draw the counters in the footer. */
+	void (*lives)(struct renderer *r, int lives);
+	void (*level)(struct renderer *r, int level);
+	void (*score)(struct renderer *r, unsigned int score);
+
+	/* Draws everything again from scratch. */
+	void (*redraw)(struct renderer *r, const struct game *game);
+
+	/* Shows a message centered on the play field. Lines are separated by
+	 * newlines. */
+	void (*message)(struct renderer *r, const char *text);
+
+	/* Shows the player everything drawn since the last call. */
+	void (*present)(struct renderer *r);
+};
+
+/*
+ * Where the player's input comes from, and the clock that decides when frames
+ * are due. Frames are numbered from the start of the game, starting at 1.
+ */
+struct input {
+	/* Returns the number of the last frame that is due to be simulated by
+	 * now. */
+	unsigned long (*due)(struct input *in);
+
+	/* Waits until the given frame is due, or until there is input. If
+	 * frame is 0, waits until there is input. */
+	void (*wait)(struct input *in, unsigned long frame);
+
+	/* Reads all of the input since the last call into controls. frame is
+	 * the next frame to be simulated, which is the first one the controls
+	 * will act on, and isPaused is whether the game is paused going into
+	 * it. */
+	void (*read)(struct input *in, struct controls *controls,
+			unsigned long frame, int isPaused);
+
+	/* Starts the clock again after the game was held up, so that the
+	 * given frame is the next one due. */
+	void (*resume)(struct input *in, unsigned long frame);
+
+	/* Waits for the player to press any key. */
+	void (*anykey)(struct input *in);
+};
+
+/*
+ * Everything about one game, from the first level to game over.
+ */
+struct game {
+	/* Dimensions of the play field, and the number of block columns that
+	 * fit across it. */
+	int width;
+	int height;
+	int columns;
+
+	/* The rest of the rules the game is played by: see struct rules. */
+	int startBalls;
+	int multiball;
+	const struct levelPack *levels;
+
+	/* Everything below, up to level, belongs to the level being played,
+	 * and is allocated from arena when the level starts. */
+	struct arena arena;
+
+	/* 2D array representing the play field, one row at a time, with an
+	 * enum tile in each byte: use TILE() to get at it. Randomly generated
+	 * on each level. */
+	uint8_t *board;
+
+	/* The blocks left on the board, one bit per block. Each row takes
+	 * rowWords words: bit k of the row is set if block k of the row is
+	 * still there. Bit y of blockRows is set if there are any blocks left
+	 * in row y, and blockCount is how many blocks are left in all. */
+	uint64_t *blocks;
+	uint64_t *blockRows;
+	int rowWords;
+	int blockCount;
+
+	struct balls balls;
+	struct paddle *paddle;
+
+	int level;
+	unsigned int score;
+	int lives;
+
+	/* How many frames have been simulated since the start of the game,
+	 * and since the start of the life, and how many blocks have been
+	 * destroyed. */
+	unsigned long frames;
+	unsigned int lifeFrames;
+	unsigned long blocksDestroyed;
+
+	/* Whether the game was resumed from a snapshot (see snapshot.h) in
+	 * the middle of a life, so that the next call to play() carries on
+	 * with that life instead of starting the level over. */
+	int resumed;
+
+	/* Where the game gets its random numbers from, and the seed it
+	 * started with. */
+	struct rng rng;
+	uint64_t seed;
+
+	struct renderer *renderer;
+	struct input *input;
+};
+
+/*
+ * The amount of lives the player starts out with at the beginning of the game.
+ */
+extern const int STARTING_LIVES;
+
+int blocksInRow(const struct game *game, int y);
+int blocksLeft(const struct game *game);
+int checkBalls(struct game *game, const struct paddle *paddle);
+uint32_t checksumBoard(const struct game *game);
+void destroyBlock(struct game *game, int x, int y);
+void freeGame(struct game *game);
+void generateBoard(struct game *game, const int level, const int maxBlockY);
+int initGame(struct game *game, const struct rules *rules, int level,
+		uint64_t seed, struct renderer *renderer, struct input *input);
+int isBlock(const struct game *game, int x, int y);
+int lowestBlock(const struct game *game);
+int max(int a, int b);
+int min(int a, int b);
+void moveBall(struct game *game, int i, int x, int y);
+void movePaddle(struct game *game, struct paddle *paddle);
+unsigned int nextMove(const struct balls *balls,
+		const struct paddle *paddle, unsigned int frame, int isPaused);
+int play(struct game *game);
+void playGame(struct game *game);
+void showMessage(struct game *game, const char *fmt, ...);
+void updateTile(struct game *game, int x, int y);
+
+#endif /* GAME_H */
@@ -0,0 +1,163 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "headless.h"
+
+/*
+ * Almost three hours of play, which is a lot longer than a game takes with
+ * nobody playing.
+ */
+const unsigned long HEADLESS_FRAME_LIMIT = 2000000;
+
+static void headlessAnykey(struct input *in);
+static unsigned long headlessDue(struct input *in);
+static void headlessRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void headlessResume(struct input *in, unsigned long frame);
+static void headlessWait(struct input *in, unsigned long frame);
+static void nullLevel(struct renderer *r, int level);
+static void nullLives(struct renderer *r, int lives);
+static void nullMessage(struct renderer *r, const char *text);
+static void nullPresent(struct renderer *r);
+static void nullRedraw(struct renderer *r, const struct game *game);
+static void nullScore(struct renderer *r, unsigned int score);
+static void nullTile(struct renderer *r, int x, int y, enum tile t);
+
+struct renderer nullRenderer = {
+	nullTile,
+	nullLives,
+	nullLevel,
+	nullScore,
+	nullRedraw,
+	nullMessage,
+	nullPresent,
+};
+
+static void
+headlessAnykey(struct input *in)
+{
+	(void)in;
+}
+
+static unsigned long
+headlessDue(struct input *in)
+{
+	return ((struct headless *)in)->now;
+}
+
+static void
+headlessRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused)
+{
+	struct headless *headless = (struct headless *)in;
+
+	(void)isPaused;
+	controls->direction = 0;
+	controls->togglePause = 0;
+	controls->quit = 0;
+	controls->redraw = 0;
+	if (headless->limit != 0 && frame > headless->limit) {
+		controls->quit = 1;
+		headless->stopped = 1;
+	}
+}
+
+static void
+headlessResume(struct input *in, unsigned long frame)
+{
+	((struct headless *)in)->now = frame - 1;
+}
+
+static void
+headlessWait(struct input *in, unsigned long frame)
+{
+	struct headless *headless = (struct headless *)in;
+
+	/* There will never be any input to wait for, so if nothing is going to
+	 * move, don't wait at all. */
+	if (frame > headless->now) {
+		headless->now = frame;
+	}
+}
+
+/*
+ * Sets up a headless input, with no frames due yet, that quits the game after
+ * limit frames, or never if limit is 0.
+ */
+void
+initHeadless(struct headless *headless, unsigned long limit)
+{
+	headless->input.due = headlessDue;
+	headless->input.wait = headlessWait;
+	headless->input.read = headlessRead;
+	headless->input.resume = headlessResume;
+	headless->input.anykey = headlessAnykey;
+	headless->now = 0;
+	headless->limit = limit;
+	headless->stopped = 0;
+}
+
+static void
+nullLevel(struct renderer *r, int level)
+{
+	(void)r;
+	(void)level;
+}
+
+static void
+nullLives(struct renderer *r, int lives)
+{
+	(void)r;
+	(void)lives;
+}
+
+static void
+nullMessage(struct renderer *r, const char *text)
+{
+	(void)r;
+	(void)text;
+}
+
+static void
+nullPresent(struct renderer *r)
+{
+	(void)r;
+}
+
+static void
+nullRedraw(struct renderer *r, const struct game *game)
+{
+	(void)r;
+	(void)game;
+}
+
+static void
+nullScore(struct renderer *r, unsigned int score)
+{
+	(void)r;
+	(void)score;
+}
+
+static void
+nullTile(struct renderer *r, int x, int y, enum tile t)
+{
+	(void)r;
+	(void)x;
+	(void)y;
+	(void)t;
+}
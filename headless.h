@@ -0,0 +1,57 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Running the game without a terminal, as fast as it will go.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "game.h"
+
+/*
+ * An input with no player behind it. Its clock doesn't follow real time:
+ * waiting for a frame jumps straight to it.
+ */
+struct headless {
+	struct input input;
+
+	/* The last frame that is due. */
+	unsigned long now;
+
+	/* With nobody at the controls, the ball can get stuck bouncing
+	 * around forever, so the game is quit after this many frames (unless
+	 * it is 0). stopped is set if that happens. */
+	unsigned long limit;
+	int stopped;
+};
+
+/*
+ * The default for limit.
+ */
+extern const unsigned long HEADLESS_FRAME_LIMIT;
+
+/*
+ * A renderer that doesn't draw anything.
+ */
+extern struct renderer nullRenderer;
+
+void initHeadless(struct headless *headless, unsigned long limit);
+
+#endif /* HEADLESS_H */
@@ -0,0 +1,260 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "instrument.h"
+
+/*
+ * Every measurement of the same kind goes into a histogram, which has a fixed
+ * number of buckets however many measurements there are. Values less than
+ * SUB_BUCKETS each have a bucket of their own. Above that, each power of two
+ * is split into SUB_BUCKETS buckets of the same width, so that each bucket is
+ * at most an eighth as wide as the values in it are big.
+ */
+#define SUB_BITS 3
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define BUCKETS ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+struct histogram {
+	unsigned long count[BUCKETS];
+	unsigned long total;
+	unsigned long long max;
+};
+
+static unsigned long bucket(unsigned long long value);
+static unsigned long long percentile(const struct histogram *h, int percent);
+static void record(struct histogram *h, unsigned long long value);
+static unsigned long long upperBound(unsigned long b);
+
+/*
+ * Nothing is measured until instrumentBegin() is called, so that games played
+ * side by side in a batch, which would muddle each other's numbers, stay out
+ * of it.
+ */
+static int enabled;
+
+/*
+ * How long each phase took, in nanoseconds, and how many bytes were written
+ * and system calls made in each frame. The system calls made since the end of
+ * the last frame are counted in frameBytes and frameSyscalls. The render
+ * thread measures its own writes, so everything here is only touched with
+ * lock held.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct histogram phases[PHASES];
+static struct histogram bytes;
+static struct histogram syscalls;
+static unsigned long long frameBytes;
+static unsigned long long frameSyscalls;
+
+/*
+ * The names of the phases, as they are reported.
+ */
+static const char *PHASE_NAMES[PHASES] = {
+	[PHASE_INPUT] = "input",
+	[PHASE_PHYSICS] = "physics",
+	[PHASE_RENDER] = "render",
+	[PHASE_FLUSH] = "flush",
+};
+
+/*
+ * Returns the bucket of a histogram that value goes in.
+ */
+static unsigned long
+bucket(unsigned long long value)
+{
+	int bit = 0;
+
+	if (value < SUB_BUCKETS) {
+		return (unsigned long)value;
+	}
+	while (value >> bit >> 1 != 0) {
+		bit++;
+	}
+	return (unsigned long)(bit - SUB_BITS + 1) * SUB_BUCKETS
+		+ (unsigned long)(value >> (bit - SUB_BITS) & (SUB_BUCKETS - 1));
+}
+
+/*
+ * Starts measuring. This has to be called before anything is measured, and
+ * before any other thread that measures things is started.
+ */
+void
+instrumentBegin(void)
+{
+	enabled = 1;
+}
+
+/*
+ * Returns the time in nanoseconds on a clock that only ever goes forward.
+ */
+long long
+instrumentClock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Ends a frame: the bytes written and system calls made since the last one are
+ * counted against it.
+ */
+void
+instrumentFrame(void)
+{
+	if (!enabled) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	record(&bytes, frameBytes);
+	record(&syscalls, frameSyscalls);
+	frameBytes = 0;
+	frameSyscalls = 0;
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Records that phase took ns nanoseconds.
+ */
+void
+instrumentPhase(enum phase phase, long long ns)
+{
+	if (!enabled) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	record(&phases[phase], ns > 0 ? (unsigned long long)ns : 0);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Writes out a table of how long each phase took and how much was sent for
+ * each frame: the median, the 99th percentile, and the most.
+ */
+void
+instrumentReport(FILE *f)
+{
+	if (!enabled) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	fprintf(f, "%-16s %10s %10s %10s %10s\n", "", "count", "p50", "p99",
+			"max");
+	for (int i = 0; i < PHASES; i++) {
+		fprintf(f, "%-7s%9s %10lu %10.1f %10.1f %10.1f\n",
+				PHASE_NAMES[i], "(us)", phases[i].total,
+				percentile(&phases[i], 50) / 1e3,
+				percentile(&phases[i], 99) / 1e3,
+				phases[i].max / 1e3);
+	}
+	fprintf(f, "%-16s %10lu %10llu %10llu %10llu\n", "bytes/frame",
+			bytes.total, percentile(&bytes, 50),
+			percentile(&bytes, 99), bytes.max);
+	fprintf(f, "%-16s %10lu %10llu %10llu %10llu\n", "syscalls/frame",
+			syscalls.total, percentile(&syscalls, 50),
+			percentile(&syscalls, 99), syscalls.max);
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Writes a line of the 99th percentiles so far into buf, which holds size
+ * bytes, to be shown while the game is played.
+ */
+void
+instrumentSummary(char *buf, size_t size)
+{
+	pthread_mutex_lock(&lock);
+	snprintf(buf, size, "p99 in %lluus phys %lluus draw %lluus "
+			"out %lluus %lluB %llusys",
+			percentile(&phases[PHASE_INPUT], 99) / 1000,
+			percentile(&phases[PHASE_PHYSICS], 99) / 1000,
+			percentile(&phases[PHASE_RENDER], 99) / 1000,
+			percentile(&phases[PHASE_FLUSH], 99) / 1000,
+			percentile(&bytes, 99), percentile(&syscalls, 99));
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Records a system call made for the game, which wrote the given number of
+ * bytes to the terminal.
+ */
+void
+instrumentSyscall(long written)
+{
+	if (!enabled) {
+		return;
+	}
+	pthread_mutex_lock(&lock);
+	frameSyscalls++;
+	if (written > 0) {
+		frameBytes += (unsigned long long)written;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Returns the value that percent percent of the values in h are no more than,
+ * to within the width of a bucket, or 0 if h is empty.
+ */
+static unsigned long long
+percentile(const struct histogram *h, int percent)
+{
+	/* The rank of the value wanted, counting from 1, rounded up. */
+	const unsigned long rank = (h->total * percent + 99) / 100;
+	unsigned long seen = 0;
+
+	for (unsigned long b = 0; b < BUCKETS; b++) {
+		seen += h->count[b];
+		if (seen >= rank && seen > 0) {
+			const unsigned long long value = upperBound(b);
+			return value < h->max ? value : h->max;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Adds value to h.
+ */
+static void
+record(struct histogram *h, unsigned long long value)
+{
+	h->count[bucket(value)]++;
+	h->total++;
+	if (value > h->max) {
+		h->max = value;
+	}
+}
+
+/*
+ * Returns the biggest value that goes in bucket b.
+ */
+static unsigned long long
+upperBound(unsigned long b)
+{
+	if (b < SUB_BUCKETS) {
+		return b;
+	}
+	const int shift = (int)(b / SUB_BUCKETS) - 1;
+	const unsigned long long low = (SUB_BUCKETS + b % SUB_BUCKETS)
+		<< shift;
+	return low + (1ULL << shift) - 1;
+}
@@ -0,0 +1,75 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measurements of where the time goes in each frame, and of how much is sent
+ * to the terminal for it, for finding out why a game runs slowly. They are
+ * only built in when INSTRUMENT is set to 1 (make INSTRUMENT=1); otherwise the
+ * INSTRUMENT_ macros expand to nothing, and cost nothing.
+ */
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * The parts of a frame that are timed. PHASE_FLUSH is the time taken writing
+ * the screen out to the terminal, which is part of PHASE_RENDER unless the
+ * screen is sent by a render thread.
+ */
+enum phase {
+	PHASE_INPUT,
+	PHASE_PHYSICS,
+	PHASE_RENDER,
+	PHASE_FLUSH,
+	PHASES,
+};
+
+#if INSTRUMENT
+/* Declares t, and starts it timing. */
+#define INSTRUMENT_START(t) long long t = instrumentClock()
+/* Records the time since INSTRUMENT_START(t) against phase. */
+#define INSTRUMENT_END(phase, t) \
+	instrumentPhase((phase), instrumentClock() - (t))
+/* Records that phase took ns nanoseconds. */
+#define INSTRUMENT_TIME(phase, ns) instrumentPhase((phase), (ns))
+/* Records a system call, which wrote the given number of bytes to the
+ * terminal. */
+#define INSTRUMENT_SYSCALL(written) instrumentSyscall(written)
+/* Ends the frame, which the system calls since the last one are counted
+ * against. */
+#define INSTRUMENT_FRAME() instrumentFrame()
+#else
+#define INSTRUMENT_START(t)
+#define INSTRUMENT_END(phase, t)
+#define INSTRUMENT_TIME(phase, ns)
+#define INSTRUMENT_SYSCALL(written)
+#define INSTRUMENT_FRAME()
+#endif /* INSTRUMENT */
+
+void instrumentBegin(void);
+long long instrumentClock(void);
+void instrumentFrame(void);
+void instrumentPhase(enum phase phase, long long ns);
+void instrumentReport(FILE *f);
+void instrumentSummary(char *buf, size_t size);
+void instrumentSyscall(long written);
+
+#endif /* INSTRUMENT_H */
@@ -0,0 +1,218 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "levels.h"
+
+static const char MAGIC[4] = { 'A', 'B', 'L', 'V' };
+static const int VERSION = 1;
+
+/*
+ * Sizes of the header and of each entry of the index, in bytes.
+ */
+#define HEADER_SIZE 12
+#define ENTRY_SIZE 8
+
+static size_t blocksSize(int columns, int rows);
+static unsigned long readNumber(const unsigned char *p, int bytes);
+static void writeNumber(FILE *file, unsigned long value, int bytes);
+
+/*
+ * Returns how many bytes the blocks of a level take up.
+ */
+static size_t
+blocksSize(int columns, int rows)
+{
+	return ((size_t)columns * rows + 3) / 4;
+}
+
+/*
+ * Unmaps a pack opened with openLevelPack().
+ */
+void
+closeLevelPack(struct levelPack *pack)
+{
+	munmap((void *)pack->data, pack->size);
+}
+
+/*
+ * Finds level number (counting from 1) of pack. Past the last level, the pack
+ * starts over from the first.
+ */
+void
+findLevel(const struct levelPack *pack, int number, struct level *level)
+{
+	const long i = ((number - 1L) % (long)pack->count + (long)pack->count)
+		% (long)pack->count;
+	const unsigned char *entry = pack->data + HEADER_SIZE
+		+ (size_t)i * ENTRY_SIZE;
+
+	level->blocks = pack->data + readNumber(entry, 4);
+	level->columns = (int)readNumber(entry + 4, 2);
+	level->rows = (int)readNumber(entry + 6, 2);
+}
+
+/*
+ * Returns what is at block k of row y of level: 0 if there is no block there,
+ * or 1, 2 or 3 for a red, blue or green one.
+ */
+int
+levelBlock(const struct level *level, int k, int y)
+{
+	if (k < 0 || k >= level->columns || y < 0 || y >= level->rows) {
+		return 0;
+	}
+	const size_t i = (size_t)y * level->columns + k;
+	return level->blocks[i / 4] >> (2 * (i % 4)) & 3;
+}
+
+/*
+ * Maps the level pack at path into memory. Only the header and the index are
+ * looked at, to make sure every level is all there. Returns 0 on success, or
+ * -1 with errno set if the file can't be read or isn't a level pack. The pack
+ * has to be closed with closeLevelPack().
+ */
+int
+openLevelPack(struct levelPack *pack, const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) != 0) {
+		int saved = errno;
+		close(fd);
+		errno = saved;
+		return -1;
+	}
+	if (st.st_size < HEADER_SIZE) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	pack->size = (size_t)st.st_size;
+	void *data = mmap(NULL, pack->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int saved = errno;
+	close(fd);
+	if (data == MAP_FAILED) {
+		errno = saved;
+		return -1;
+	}
+	pack->data = data;
+
+	if (memcmp(pack->data, MAGIC, sizeof(MAGIC)) != 0
+			|| pack->data[4] != VERSION) {
+		goto invalid;
+	}
+	pack->count = readNumber(pack->data + 8, 4);
+	if (pack->count == 0 || pack->count > (pack->size - HEADER_SIZE)
+			/ ENTRY_SIZE) {
+		goto invalid;
+	}
+	for (unsigned long i = 0; i < pack->count; i++) {
+		const unsigned char *entry = pack->data + HEADER_SIZE
+			+ i * ENTRY_SIZE;
+		const unsigned long offset = readNumber(entry, 4);
+		const size_t size = blocksSize((int)readNumber(entry + 4, 2),
+				(int)readNumber(entry + 6, 2));
+		if (offset > pack->size || size > pack->size - offset) {
+			goto invalid;
+		}
+	}
+	return 0;
+
+invalid:
+	closeLevelPack(pack);
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Returns the little-endian number of the given number of bytes at p.
+ */
+static unsigned long
+readNumber(const unsigned char *p, int bytes)
+{
+	unsigned long value = 0;
+
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = value << 8 | p[i];
+	}
+	return value;
+}
+
+/*
+ * Writes value to file as a little-endian number of the given number of
+ * bytes.
+ */
+static void
+writeNumber(FILE *file, unsigned long value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		putc((int)(value >> (8 * i)) & 0xff, file);
+	}
+}
+
+/*
+ * Writes count levels to a new level pack at path. Returns 0 on success, or -1
+ * with errno set if it couldn't be written.
+ */
+int
+writeLevelPack(const char *path, const struct level *levels,
+		unsigned long count)
+{
+	FILE *file = fopen(path, "wb");
+	unsigned long offset = HEADER_SIZE + count * ENTRY_SIZE;
+
+	if (file == NULL) {
+		return -1;
+	}
+	fwrite(MAGIC, 1, sizeof(MAGIC), file);
+	writeNumber(file, (unsigned long)VERSION, 4);
+	writeNumber(file, count, 4);
+	for (unsigned long i = 0; i < count; i++) {
+		writeNumber(file, offset, 4);
+		writeNumber(file, (unsigned long)levels[i].columns, 2);
+		writeNumber(file, (unsigned long)levels[i].rows, 2);
+		offset += blocksSize(levels[i].columns, levels[i].rows);
+	}
+	for (unsigned long i = 0; i < count; i++) {
+		fwrite(levels[i].blocks, 1, blocksSize(levels[i].columns,
+				levels[i].rows), file);
+	}
+
+	int failed = ferror(file);
+	if (fclose(file) != 0) {
+		return -1;
+	}
+	if (failed) {
+		errno = EIO;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Level packs: boards laid out ahead of time, to be played instead of random
+ * ones. A pack is mapped into memory rather than read, and any level in it can
+ * be found straight from its index, so a big pack costs nothing to open.
+ *
+ * All numbers in a pack are little-endian. It starts with a header:
+ *
+ *	4 bytes		"ABLV"
+ *	1 byte		version (1)
+ *	3 bytes		0
+ *	4 bytes		the number of levels
+ *
+ * followed by an index, with an entry for each level:
+ *
+ *	4 bytes		where the level's blocks start, from the start of the file
+ *	2 bytes		columns: how many blocks across the level is
+ *	2 bytes		rows: how many blocks down the level is
+ *
+ * A level's blocks take 2 bits each: 0 for no block, or 1, 2 or 3 for a red,
+ * blue or green one. They go a row at a time from the top of the board, and
+ * left to right along each row, four to a byte starting from the low bits.
+ * Block k of a row covers x = BLOCK_X + 2k and the tile after it (see game.h).
+ */
+
+#ifndef LEVELS_H
+#define LEVELS_H
+
+#include <stddef.h>
+
+/*
+ * A level pack that has been opened.
+ */
+struct levelPack {
+	const unsigned char *data;
+	size_t size;
+	unsigned long count;
+};
+
+/*
+ * One level of a pack.
+ */
+struct level {
+	int columns;
+	int rows;
+	const unsigned char *blocks;
+};
+
+void closeLevelPack(struct levelPack *pack);
+void findLevel(const struct levelPack *pack, int number, struct level *level);
+int levelBlock(const struct level *level, int k, int y);
+int openLevelPack(struct levelPack *pack, const char *path);
+int writeLevelPack(const char *path, const struct level *levels,
+		unsigned long count);
+
+#endif /* LEVELS_H */
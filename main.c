@@ -16,712 +16,452 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>. 
  */
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
 #include <signal.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-
-#include "rogueutil.h"
-
-/*
- * Store data about the ball, including location and velocity.
- */
-struct ball {
-	/* Coordinates of the ball in board. */
-	int x;
-	int y;
-
-	/* How many frames the ball moves in each axis. For example, if
-	 * xVelocity was 1, then the ball would move on the x axis every frame.
-	 * However, if xVelocity was 3, then the ball would move on the x axis
-	 * every 3 frames. */
-	int xVelocity;
-	int yVelocity;
-
-	/* How many tiles the ball moves on each axis, on a frame where it
-	 * moves in that axis. */
-	int xDirection; /* negative is left, positive is right. */
-	int yDirection; /* negative is up, positive is down. */
-};
-
-/*
- * Store data about the paddle, including location and direction.
- */
-struct paddle {
-	/* Coordinates (in board) of the left-most character in the paddle. */
-	int x;
-	int y;
-
-	/* Length of the paddle. */
-	int len;
-
-	/* Direction the paddle is moving - negative for left, positive for
-	 * right. */
-	int direction;
-
-	/* The last direction the paddle was moving before it was frozen. */
-	int lastDirection;
-
-	/* used to control speed of the paddle */
-	int velocity;
-};
-
-/*
- * Stores data about each tile (character space) on the board, namely, what it
- * represents.
- */
-enum tile {
-	BALL = 'O',
-	PADDLE = MAGENTA,
-	RED_BLOCK = RED,
-	BLUE_BLOCK = BLUE,
-	GREEN_BLOCK = GREEN,
-	EMPTY = 0,
-};
-
-
-/*
- * Dimensions of the play field. I used #define instead of const int for these
- * so that I can declare board (see below) at file scope.
- */
-#define WIDTH 60
-#define HEIGHT 36
+#include <unistd.h>
+
+#include "autopilot.h"
+#include "batch.h"
+#include "game.h"
+#include "headless.h"
+#include "instrument.h"
+#include "levels.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "term.h"
+
+void checkRules(const char *argv0, const struct rules *rules);
+void cleanup(int sig);
+void usage(const char *argv0);
 
 /*
- * Strings for the footer at the bottom of the game board.
+ * Whether the game is being played in the terminal, as opposed to simulated
+ * headless.
  */
-const char *TITLE = "ASCII BREAKOUT";
-const char *LIVES_FOOTER = "<3:";
-const char *LEVEL_FOOTER = "Level:";
-const char *SCORE_FOOTER = "Score:";
-const int INBETWEEN = 5;
-const int FOOTER_XPOS = 4;
-const int FOOTER_YPOS = HEIGHT + 2;
+int usingTerminal = 0;
 
 /*
- * The amount of lives the player starts out with at the beginning of the game.
+ * Whether the game is being saved, and where to.
  */
-const int STARTING_LIVES = 5;
+volatile sig_atomic_t autosaving = 0;
+struct autosave autosave;
 
 /*
- * 2D array representing the play field. Randomly generated on each level.
+ * The signal that a game being saved was quit on, once it saves itself at the
+ * end of the frame, or 0.
  */
-enum tile board[WIDTH][HEIGHT];
-
-void bar(int x, int y, int len, char c);
-int checkBall(struct ball *ball, int *blocksLeft, unsigned int *score,
-		unsigned int frame);
-void cleanup(int sig);
-void destroyBlock(int x, int y, int *blocksLeft, unsigned int *score);
-void drawTile(int x, int y, enum tile t);
-int generateBoard(const int level, const int maxBlockY,
-		struct paddle paddle, struct ball ball);
-void initializeGraphics(int level, unsigned int score,
-		int lives);
-int max(int a, int b);
-int min(int a, int b);
-void moveBall(struct ball *ball, int x, int y);
-void movePaddle(struct paddle *paddle);
-int play(int level, unsigned int *score, int *lives);
-void showMessage(char *fmt, ...);
-void updateLevel(int *level);
-void updateLives(int *lives);
-void updateScore(unsigned int *score);
-void updateTile(int x, int y);
+volatile sig_atomic_t quitSignal = 0;
 
 /*
- * Draws a horizontal bar across the screen.
+ * Exits unsuccessfully if a game can't be played by rules: if the board is too
+ * small or too big to play on, or there are too many or too few balls.
  */
 void
-bar(int x, int y, int len, char c)
+checkRules(const char *argv0, const struct rules *rules)
 {
-	locate(x, y);
-	for (int i = 0; i < len; i++) {
-		putchar(c);
+	if (rules->width < MIN_WIDTH || rules->width > MAX_WIDTH
+			|| rules->height < MIN_HEIGHT
+			|| rules->height > MAX_HEIGHT) {
+		fprintf(stderr, "%s: the board must be from %dx%d to %dx%d, "
+				"not %dx%d\n", argv0, MIN_WIDTH, MIN_HEIGHT,
+				MAX_WIDTH, MAX_HEIGHT, rules->width,
+				rules->height);
+		exit(EXIT_FAILURE);
+	}
+	if (rules->balls < 1 || rules->balls > MAX_BALLS) {
+		fprintf(stderr, "%s: there must be from 1 to %d balls, not "
+				"%d\n", argv0, MAX_BALLS, rules->balls);
+		exit(EXIT_FAILURE);
 	}
 }
 
 /*
- * Checks to see if the ball should move this frame. If it should, then
- * moveBall will be called. Also handles collision and bouncing. Returns 0 if
- * the ball reaches the bottom of the play field, otherwise returns 1.
+ * Intercepts signals, particularly ^C SIGINT, or cleans up at the end of the
+ * game if sig is 0.
  */
-int
-checkBall(struct ball *ball, int *blocksLeft, unsigned int *score,
-		unsigned int frame)
+void
+cleanup(int sig)
 {
-	/* The new coordinates of the ball, if it moves successfully. */
-	int nextX = (*ball).x, nextY = (*ball).y;
-
-
-	if (frame % (*ball).xVelocity == 0) {
-		nextX += (*ball).xDirection;
-	}
-	if (frame % (*ball).yVelocity == 0) {
-		nextY += (*ball).yDirection;
-	}
-
-	/* Don't do anything if the ball didn't change position. */
-	if (nextX == (*ball).x && nextY == (*ball).y) {
-		return 1;
+	if (sig == 0) {
+		/* Clean up the modifications made to the terminal settings
+		 * before quitting the program. */
+		if (usingTerminal) {
+			terminalEnd();
+		}
+		return;
 	}
 
-	/* The ball has hit the bottom of the game field. */
-	if (nextY >= HEIGHT) {
-		return 0;
+	/* A game that is being saved is saved before quitting on a signal,
+	 * right away if it is between frames. Otherwise, it saves itself and
+	 * quits at the end of the frame, and is cleaned up the usual way. */
+	if (autosaving && !saveOnSignal(&autosave)) {
+		quitSignal = sig;
+		return;
 	}
 
-	/* if the incoming tile is valid and empty, move there */
-	if (nextX >= 0 && nextX < WIDTH && nextY >= 0
-			&& board[nextX][nextY] == EMPTY) {
-		moveBall(ball, nextX, nextY);
-	/* otherwise, bounce! */
-	/* if stuck in a corner, invert both directions */
-	} else if (nextY == 0 && (nextX == 0 || nextX == WIDTH - 1)) {
-		(*ball).xDirection = -(*ball).xDirection;
-		(*ball).yDirection = -(*ball).yDirection;
-	/* bounce off the side walls */
-	} else if (nextX <= 0 || nextX >= WIDTH) { 
-		(*ball).xDirection = -(*ball).xDirection;
-	/* bounce off the ceiling */
-	} else if (nextY <= 0) {
-		(*ball).yDirection = -(*ball).yDirection;
-	/* bounce off paddle */
-	} else if (board[nextX][nextY] == PADDLE) {
-		/* If yDirection is not inverted here, then the ball will just
-		 * roll about on the paddle for a little bit, which is actually
-		 * kindof fun. Try it out if you're bored. */
-		(*ball).yDirection = -(*ball).yDirection;
-		/* randomize bounce and velocity */
-		if (rand() % 2 == 0)
-			(*ball).xDirection = -(*ball).xDirection;
-		(*ball).xVelocity = (rand() % 8) + 5;
-		(*ball).yVelocity = (rand() % 8) + 5;
-	/* bounce off (and destroy) block */
-	} else { 
-		destroyBlock(nextX, nextY, blocksLeft, score);
-		if (rand() % 2 == 0)
-			(*ball).xDirection = -(*ball).xDirection;
-		if (rand() % 2 == 0)
-			(*ball).yDirection = -(*ball).yDirection;
+	/* Whatever was interrupted can't be cleaned up from here: the
+	 * terminal is put back as it was, and the rest goes with the
+	 * process. */
+	if (usingTerminal) {
+		terminalRestore();
 	}
-
-	/* Indicates that the ball did not hit the bottom of the play field. */
-	return 1;
-}
-
-/*
- * Intercepts signals, particularly ^C SIGINT.
- */
-void
-cleanup(int sig)
-{
-	/* Clean up the modifications made to the terminal settings before
-	 * quitting the program. */
-	setCursorVisibility(1);
-	resetColor();
-	locate(1, HEIGHT + 3);
+	_exit(128 + sig);
 }
 
 /*
- * Destroys a block at board[x][y], and replaces it with EMPTY. Intended to be
- * called when the ball bounces into a block.
+ * Prints how to use the program, and exits unsuccessfully.
  */
 void
-destroyBlock(int x, int y, int *blocksLeft, unsigned int *score)
+usage(const char *argv0)
 {
-	/* Blocks are generated in groups of two, which means that if one block
-	 * tile is hit, then one of its neighbors is also going to be
-	 * destroyed. Because of the way the board is generated, the first tile
-	 * in a block is always odd. We can use this fact to determine which
-	 * tile of the block the ball hit: the first or the second. If the x
-	 * value is odd, then the ball hit the first; if it is even, the the
-	 * ball hit the second. This is interpreted as an offset to the x value
-	 * which, when added to the x value, will give us the coordinate of the
-	 * second tile in the block. */
-	int offset = (x % 2 == 1) ? 1 : -1;
-	board[x][y] = EMPTY;
-	updateTile(x, y);
-	board[x + offset][y] = EMPTY;
-	updateTile(x + offset, y);
-	/* Remove a block from the total. */
-	(*blocksLeft)--;
-	/* Give the player points for destroying a block. */
-	*score += 10;
-	updateScore(score);
+	fprintf(stderr, "usage: %s [--headless] [--max-frames n] [--seed n] "
+			"[--width n] [--height n] [--fit]\n"
+			"       [--balls n] [--multiball] [--low-bandwidth] "
+			"[--render-thread] [--ai]\n"
+			"       [--levels file] [--record file] [--replay file] "
+			"[--save file]\n"
+			"       [--resume file] [--broadcast [address:]port] "
+			"[level]\n"
+			"       %s --batch n [--threads n] [--max-frames n] "
+			"[--seed n]\n"
+			"       [--width n] [--height n] [--balls n] "
+			"[--multiball] [--ai]\n"
+			"       [--levels file] [--resume file] [level]\n",
+			argv0, argv0);
+	exit(EXIT_FAILURE);
 }
 
-/*
- * Draws at (x, y) [on the terminal window] the proper value depending on the
- * tile, including the proper color. Does not reset colors after usage.
- */
-void
-drawTile(int x, int y, enum tile t)
-{
-	/* alternates the character drawn for blocks */
-	static int alternateBlockChar = 1;
-	resetColor();
-	locate(x, y);
-	switch (t) {
-	case BALL:
-		setChar(t);
-		break;
-	case PADDLE:
-		setBackgroundColor(t);
-		setChar(' ');
-		break;
-	case RED_BLOCK:
-	case BLUE_BLOCK:
-	case GREEN_BLOCK:
-		setBackgroundColor(t);
-		setColor(BLACK);
-		/* This helps show the player that blocks are two characters
-		 * wide. */
-		setChar(alternateBlockChar ? '(' : ')');
-		alternateBlockChar = !alternateBlockChar;
-		break;
-	case EMPTY:
-	default:
-		setChar(' ');
-		break;
-	}
-}
-
-/*
- * Generates a starting game board. Returns the amount of blocks it generated
- * in the level.
- */
 int
-generateBoard(const int level, const int maxBlockY, struct paddle paddle,
-		struct ball ball)
+main(int argc, char *argv[])
 {
-	/* Initializes the board to be empty */
-	memset(board, EMPTY, WIDTH * HEIGHT * sizeof(enum tile));
-	/* Create the paddle. */
-	for (int i = 0; i < paddle.len; i++) {
-		board[paddle.x + i][paddle.y] = PADDLE;
-	}
-	/* Create the ball. */
-	board[ball.x][ball.y] = BALL;
-
-	int blocks = 0;
-	/* Fills in a section of the board with breakable blocks. */
-	for (int i = 3; i < WIDTH - 3; i += 2) {
-		/* maxBlockY is the lowest distance the blocks can be
-		 * generated. */
-		for (int j = 3; j < maxBlockY; j++) {
-			blocks++;
-			switch (rand() % 3) {
-			case 0:
-				board[i][j] = RED_BLOCK;
-				board[i + 1][j] = RED_BLOCK;
-				break;
-			case 1:
-				board[i][j] = BLUE_BLOCK;
-				board[i + 1][j] = BLUE_BLOCK;
-				break;
-			case 2:
-			default:
-				board[i][j] = GREEN_BLOCK;
-				board[i + 1][j] = GREEN_BLOCK;
-				break;
+	int level = 1;
+	int headless = 0;
+	uint64_t seed = time(NULL);
+	const char *recordPath = NULL;
+	const char *replayPath = NULL;
+	const char *levelsPath = NULL;
+	const char *savePath = NULL;
+	const char *resumePath = NULL;
+	unsigned long batch = 0;
+	unsigned long maxFrames = HEADLESS_FRAME_LIMIT;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int threads = cpus > 0 && cpus <= INT_MAX ? (int)cpus : 1;
+	struct rules rules = { DEFAULT_WIDTH, DEFAULT_HEIGHT, 1, 0, NULL };
+	int fit = 0;
+	int lowBandwidth = 0;
+	int renderThread = 0;
+	int ai = 0;
+	const char *broadcastAddress = NULL;
+	int broadcastPort = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			headless = 1;
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replayPath = argv[++i];
+		} else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+			levelsPath = argv[++i];
+		} else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+			savePath = argv[++i];
+		} else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+			resumePath = argv[++i];
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			char *end;
+			errno = 0;
+			batch = strtoul(argv[++i], &end, 0);
+			/* 0 would be no batch at all. */
+			if (end == argv[i] || *end != '\0' || errno != 0
+					|| argv[i][0] == '-' || batch == 0) {
+				usage(argv[0]);
+			}
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			char *end;
+			errno = 0;
+			long n = strtol(argv[++i], &end, 10);
+			if (end == argv[i] || *end != '\0' || errno != 0
+					|| n < 1 || n > INT_MAX) {
+				usage(argv[0]);
+			}
+			threads = (int)n;
+		} else if (strcmp(argv[i], "--max-frames") == 0
+				&& i + 1 < argc) {
+			maxFrames = strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+			rules.width = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+			rules.height = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--fit") == 0) {
+			fit = 1;
+		} else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+			rules.balls = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--multiball") == 0) {
+			rules.multiball = 1;
+		} else if (strcmp(argv[i], "--low-bandwidth") == 0) {
+			lowBandwidth = 1;
+		} else if (strcmp(argv[i], "--render-thread") == 0) {
+			renderThread = 1;
+		} else if (strcmp(argv[i], "--ai") == 0) {
+			ai = 1;
+		} else if (strcmp(argv[i], "--broadcast") == 0
+				&& i + 1 < argc) {
+			/* The port can come after an address to listen
+			 * on, instead of the loopback one. */
+			char *port = strrchr(argv[++i], ':'), *end;
+			struct in_addr address;
+			if (port != NULL) {
+				*port++ = '\0';
+				broadcastAddress = argv[i];
+				if (inet_pton(AF_INET, broadcastAddress,
+						&address) != 1) {
+					usage(argv[0]);
+				}
+			} else {
+				port = argv[i];
+			}
+			broadcastPort = (int)strtol(port, &end, 10);
+			if (end == port || *end != '\0' || broadcastPort < 1
+					|| broadcastPort > 65535) {
+				usage(argv[0]);
 			}
+		} else if (argv[i][0] != '-') {
+			level = atoi(argv[i]);
+		} else {
+			usage(argv[0]);
 		}
 	}
-	/* Formula for this should be (WIDTH - 6)(maxBlockY - 3) / 2, but I'm
-	 * counting it manually here just to be sure. */
-	return blocks; 
-}
 
-/*
- * Draws initial graphics for the game. This includes a box around the playing
- * field, the score, the paddle, the blocks, etc.
- */
-void
-initializeGraphics(int level, unsigned int score, int lives)
-{
-	cls();
-	/* Draws a box around the game field. */
-	setColor(GREEN);
-	bar(2, 1, WIDTH, '_'); /* Top bar */
-	for (int y = 2; y < HEIGHT + 2; y++) { /* Sides of the game field */
-		locate(1, y);
-		putchar('{');
-		locate(WIDTH + 2, y);
-		putchar('}');
+	/* Nobody can watch a game that isn't shown. */
+	if ((headless || batch > 0) && broadcastPort != 0) {
+		usage(argv[0]);
 	}
-	printf("\n{");
-	bar(2, HEIGHT + 2, WIDTH, '_'); /* Bottom bar */
-	putchar('}');
-	/* Prints footer information. */
-	/* title */
-	locate(FOOTER_XPOS, FOOTER_YPOS);
-	setColor(CYAN);
-	printf("%s", TITLE);
-	/* lives */
-	updateLives(&lives);
-	/* level */
-	updateLevel(&level);
-	/* score */
-	updateScore(&score);
-	/* Draws the board tiles. i and j refer to y and x so that blocks are
-	 * drawn in rows, not columns. This makes it easier to produce the
-	 * two-character wide block effect. */
-	for (int i = 0; i < HEIGHT; i++) {
-		for (int j = 0; j < WIDTH; j++) {
-			drawTile(j + 2, i + 2, board[j][i]);
+
+	/* The boards come from the pack instead of being random. */
+	struct levelPack levels;
+	if (levelsPath != NULL) {
+		if (openLevelPack(&levels, levelsPath) != 0) {
+			fprintf(stderr, "%s: can't load levels from %s: %s\n",
+					argv[0], levelsPath, strerror(errno));
+			return EXIT_FAILURE;
 		}
+		rules.levels = &levels;
 	}
-	fflush(stdout);
-}
-
-/*
- * Returns the maximum of two values.
- */
-int
-max(int a, int b)
-{
-	return a > b ? a : b;
-}
 
-/*
- * Returns the minimum of two values.
- */
-int
-min(int a, int b)
-{
-	return a < b ? a : b;
-}
-
-/*
- * Moves the ball to board[x][y].
- */
-void
-moveBall(struct ball *ball, int x, int y)
-{
-	board[(*ball).x][(*ball).y] = EMPTY;
-	updateTile((*ball).x, (*ball).y);
-	(*ball).x = x;
-	(*ball).y = y;
-	board[x][y] = BALL;
-	updateTile(x, y);
-}
-
-/*
- * Move the paddle according to its direction.
- */
-void
-movePaddle(struct paddle *paddle)
-{
-	/* The x-coordinate (in board) of which tiles are going to be changed.
-	 */
-
-	int newPaddleX, newEmptyX; 
-
-	/* if paddle is moving left */
-	if ((*paddle).direction < 0 && (*paddle).x + (*paddle).direction >= 0) {
-		for (int i = 0; i > (*paddle).direction; i--) {
-			newPaddleX = (*paddle).x - 1;
-			newEmptyX = (*paddle).x + (*paddle).len - 1;
-			board[newPaddleX][(*paddle).y] = PADDLE;
-			board[newEmptyX][(*paddle).y] = EMPTY;
-			updateTile(newPaddleX, (*paddle).y);
-			updateTile(newEmptyX, (*paddle).y);
-			(*paddle).x--;
+	/* A resumed game carries on with the rules and level it was saved
+	 * with, and goes on being saved where it came from, unless it is to
+	 * be saved somewhere else. A recording has to start from the
+	 * beginning of a game, so it can't be resumed. */
+	struct snapshot snapshot;
+	if (resumePath != NULL) {
+		if (recordPath != NULL || replayPath != NULL) {
+			usage(argv[0]);
 		}
-	/* if paddle is moving right */
-	} else if ((*paddle).direction > 0
-			&& (*paddle).x + (*paddle).len + (*paddle).direction <= WIDTH) {
-		for (int i = 0; i < (*paddle).direction; i++) {
-			newPaddleX = (*paddle).x + (*paddle).len;
-			newEmptyX = (*paddle).x;
-			board[newPaddleX][(*paddle).y] = PADDLE;
-			board[newEmptyX][(*paddle).y] = EMPTY;
-			updateTile(newPaddleX, (*paddle).y);
-			updateTile(newEmptyX, (*paddle).y);
-			(*paddle).x++;
+		if (loadSnapshot(&snapshot, resumePath) != 0) {
+			fprintf(stderr, "%s: can't resume %s: %s\n", argv[0],
+					resumePath, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		rules.width = snapshot.header.width;
+		rules.height = snapshot.header.height;
+		rules.balls = snapshot.header.balls;
+		rules.multiball = snapshot.header.multiball;
+		level = snapshot.header.level;
+		seed = snapshot.header.seed;
+		if (savePath == NULL && batch == 0) {
+			savePath = resumePath;
 		}
-	}
-	fflush(stdout);
-}
-
-/*
- * Plays a level of the game. Returns the amount of lives remaining at the
- * completion of the level.
- */
-int
-play(int level, unsigned int *score, int *lives)
-{
-	/* The height of the blocks (how far down on the play field they
-	 * generate) increases as the levels progress, capping at five-sixths
-	 * of the height of the board. */
-	const int maxBlockY = (HEIGHT / 3) + min(level / 2, HEIGHT / 2);
-
-	struct paddle paddle;
-	/* The paddle gets shorter as the game goes on. */
-	paddle.len = max(20 - (2 * (level / 3)), 10);
-	paddle.x = (WIDTH - paddle.len) / 2;
-	paddle.y = (11 * HEIGHT) / 12;
-	paddle.direction = 0;
-	paddle.lastDirection = 0;
-	paddle.velocity = 4;
-
-	struct ball ball;
-	ball.x = WIDTH / 2;
-	ball.y = (maxBlockY + paddle.y) / 2;
-
-	/* Give the player some extra lives every once in a while, to be nice.
-	 */
-	if (level <= 1) {
-		/* But not on the first level, since the player starts out with
-		 * some. */
-		;
-	} else if (level < 10) {
-		*lives += 2;
-	} else if (level < 20) {
-		(*lives)++;
-	/* Gives out a life every two levels now. */
-	} else if (level % 2 == 0 && level < 40) {
-		(*lives)++;
-	/* And now every four, until level 60, then the handouts end. */
-	} else if (level % 4 == 0 && level < 60) {
-		(*lives)++;
 	}
 
-	/* Generates a new board for this level. */
-	int blocksLeft = generateBoard(level, maxBlockY, paddle, ball);
-
-	/* A message is printed at the screen at the start of each level/life.
-	 * It is slightly different if you are not on level 1. */
-	char *message;
-	if (level == 1) {
-		message =
-			"ASCII Breakout\n"
-			"by Sebastian LaVine\n"
-			"Press j and k to move the paddle\n"
-			"Level: %d\nLives remaining: %d\n"
-			"Press any key to continue";
-	} else {
-		message =
-			"Level: %d\nLives remaining: %d\n"
-			"Press any key to continue";
+	/* The board can be made as big as the terminal, but a replay has to
+	 * be played on the board it was recorded on. */
+	if (fit && !headless && batch == 0 && resumePath == NULL
+			&& terminalSize(&rules.width, &rules.height) != 0) {
+		fprintf(stderr, "%s: can't tell how big the terminal is\n",
+				argv[0]);
+		return EXIT_FAILURE;
 	}
 
-	/* This is the life loop. In this loop, one life is played out. It can
-	 * loop many times within one call of play() (a level). */
-	while (*lives > 0) {
-		/* Counts how many frames of gameplay have taken place so far.
-		 */
-		unsigned int frame = 0;
-
-		/* when the game is paused, the ball freezes and
-		 * gameplay-related input is frozen. */
-		int isPaused = 0;
-
-		/* The ball resets at the start of each life. */
-		ball.x = WIDTH / 2;
-		ball.y = (maxBlockY + paddle.y) / 2;
-		ball.xVelocity = rand() % 10 + 6;
-		ball.yVelocity = rand() % 10 + 6;
-		ball.xDirection = rand() % 2 == 0 ? 1 : -1;
-		ball.yDirection = -1;
-
-		/* The paddle recenters itself and resets at the start of each
-		 * life. */
-		paddle.x = (WIDTH - paddle.len) / 2;
-		paddle.direction = 0;
-		paddle.lastDirection = 0;
-		/* Update paddle tile graphics. */
-		for (int i = 0; i < WIDTH; i++) {
-			board[i][paddle.y] = EMPTY;
+	if (batch > 0) {
+		/* Lots of headless games, from consecutive seeds, and a summary
+		 * of how they went. */
+		if (recordPath != NULL || replayPath != NULL
+				|| savePath != NULL) {
+			usage(argv[0]);
 		}
-		for (int i = 0; i < paddle.len; i++) {
-			board[paddle.x + i][paddle.y] = PADDLE;
+		checkRules(argv[0], &rules);
+		struct result *results = calloc(batch, sizeof(*results));
+		if (results == NULL) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(ENOMEM));
+			return EXIT_FAILURE;
 		}
-
-		/* Draws initial graphics for the board. */
-		initializeGraphics(level, *score, *lives);
-
-		showMessage(message, level, *lives);
-		anykey(NULL);
-		/* Redraw initial graphics to make the message go away. */
-		initializeGraphics(level, *score, *lives);
-
-		/* This is the main game loop. Input is interpreted, tiles
-		 * move, etc. */
-		for (;;) {
-			/* Controls the speed of the game; speed of the ball
-			 * and the paddle, mainly. Changing this value will
-			 * also require changing the various velocities of the
-			 * ball and paddle for gameplay to remain smooth. */
-			int sleepLength = 5;
-			msleep(sleepLength);
-			frame++;
-
-			/* There is no default case because I want the paddle
-			 * to continue to move even if there is no input. */
-			switch (nb_getch()) {
-			case 'p':
-			case 'P':
-				isPaused = !isPaused;
-				break;
-			case 'j': /* move the paddle left */
-			case 'J':
-				if (!isPaused) {
-					paddle.direction = -1;
-					paddle.lastDirection = 0;
-				}
-				break;
-			case 'k': /* move the paddle right */
-			case 'K':
-				if (!isPaused) {
-					paddle.direction = 1;
-					paddle.lastDirection = 0;
-				}
-				break;
-			case 'q': /* quits the game. */
-			case 'Q':
-				return 0;
-				break;
-			case 'r': /* redraw the screen. doesn't control the paddle. */
-			case 'R':
-				initializeGraphics(level, *score, *lives);
-				break;
-			}
-
-			if (!isPaused && paddle.direction != 0
-					&& frame % paddle.velocity == 0) {
-				movePaddle(&paddle);
-			}
-
-			/* I move the cursor out of the way so that inputs that
-			 * are not caught by nb_getch) are not in the way of
-			 * the play field. */
-			locate(WIDTH + 3, HEIGHT + 3);
-			/* Block the input characters from showing. */
-			setString("  ");
-			fflush(stdout);
-
-			if (!isPaused && !checkBall(&ball, &blocksLeft, score, frame)) {
-				(*lives)--;
-				break; /* breaks out of input loop */
-			}
-
-			/* If there are no blocks remaining, then the player
-			 * has won and moves on to the next level. */
-			if (blocksLeft == 0) {
-				return *lives;
-			}
-
+		long long start = monotonicTime();
+		int error = runBatch(results, batch, seed, level, &rules,
+				resumePath != NULL ? &snapshot : NULL,
+				maxFrames, ai, &threads);
+		if (error != 0) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(error));
+			return EXIT_FAILURE;
+		}
+		printf("seed %llu threads %d seconds %.3f\n",
+				(unsigned long long)seed, threads,
+				(monotonicTime() - start) / 1e9);
+		printSummary(stdout, results, batch);
+		free(results);
+		if (resumePath != NULL) {
+			freeSnapshot(&snapshot);
 		}
+		if (levelsPath != NULL) {
+			closeLevelPack(&levels);
+		}
+		return 0;
 	}
 
-	return *lives;
-}
+#if INSTRUMENT
+	instrumentBegin();
+#endif
+
+	struct input *input = &terminalInput;
+	struct renderer *renderer = &terminalRenderer;
+	struct headless headlessInput;
+	if (headless) {
+		/* The game plays out with nobody at the controls (unless it is
+		 * a replay), as fast as it can, and just the result is
+		 * printed. */
+		initHeadless(&headlessInput, maxFrames);
+		input = &headlessInput.input;
+		renderer = &nullRenderer;
+	}
 
-/*
- * Displays a printf(3)-formatted message, centered on the playfield.
- */
-void
-showMessage(char *fmt, ...)
-{
-	va_list ap;
-	char buffer[WIDTH * HEIGHT];
-	int line_number;
-	char *line;
-
-	va_start(ap, fmt);
-	vsnprintf(buffer, sizeof(buffer) / sizeof(*buffer), fmt, ap);
-	va_end(ap);
-
-	for (line_number = 0, line = strtok(buffer, "\n"); line != NULL;
-			line_number++, line = strtok(NULL, "\n")) {
-		locate(WIDTH / 2 - strlen(line) / 2, HEIGHT / 2 + line_number);
-		fputs(line, stdout);
+	/* A replay takes its seed, level and rules from the recording, and its
+	 * controls from the recording instead of the player. */
+	struct replay replay;
+	if (replayPath != NULL) {
+		if (ai || savePath != NULL) {
+			usage(argv[0]);
+		}
+		if (startReplay(&replay, input, replayPath, &seed, &level,
+				&rules) != 0) {
+			fprintf(stderr, "%s: can't replay %s: %s\n", argv[0],
+					replayPath, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		input = &replay.input;
 	}
 
-	fflush(stdout);
-}
+	checkRules(argv[0], &rules);
 
-/*
- * Updates the level counter in the footer.
- */
-void
-updateLevel(int *level)
-{
-	locate(FOOTER_XPOS + strlen(TITLE) + strlen(LIVES_FOOTER) +
-			(INBETWEEN * 2), FOOTER_YPOS);
-	setColor(YELLOW);
-	printf("%s", LEVEL_FOOTER);
-	resetColor();
-	printf("%02d\n", *level);
-}
+	/* The autopilot plays instead of the player, and is recorded the same
+	 * way. */
+	struct game game;
+	struct autopilot autopilot;
+	if (ai) {
+		startAutopilot(&autopilot, input, &game);
+		input = &autopilot.input;
+	}
 
-/*
- * Updates the lives counter in the footer.
- */
-void
-updateLives(int *lives)
-{
-	locate(FOOTER_XPOS + strlen(TITLE) + INBETWEEN, FOOTER_YPOS);
-	setColor(LIGHTMAGENTA);
-	printf("%s", LIVES_FOOTER);
-	resetColor();
-	printf("%02d\n", *lives);
-}
+	struct recorder recorder;
+	if (recordPath != NULL) {
+		if (startRecording(&recorder, input, recordPath, seed, level,
+				&rules) != 0) {
+			fprintf(stderr, "%s: can't record to %s: %s\n",
+					argv[0], recordPath, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		input = &recorder.input;
+	}
 
-/*
- * Updates the score counter in the footer.
- */
-void updateScore(unsigned int *score)
-{
-	locate(FOOTER_XPOS + strlen(TITLE) + strlen(LIVES_FOOTER) +
-			strlen(LEVEL_FOOTER) + (INBETWEEN * 3), FOOTER_YPOS);
-	setColor(LIGHTCYAN);
-	printf("%s", SCORE_FOOTER);
-	resetColor();
-	printf("%08u\n", *score);
-}
+	if (savePath != NULL) {
+		if (startAutosave(&autosave, input, &game, savePath) != 0) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+			return EXIT_FAILURE;
+		}
+		input = &autosave.input;
+		autosaving = 1;
+	}
 
-/*
- * Redraws the tile at board[x][y] in the window. No bounds-checking is done
- * here.
- */
-void
-updateTile(int x, int y)
-{
-	locate(x + 2, y + 2);
-	drawTile(x + 2, y + 2, board[x][y]);
-}
+	if (resumePath != NULL) {
+		int error = resumeGame(&game, &snapshot, rules.levels,
+				renderer, input);
+		freeSnapshot(&snapshot);
+		if (error != 0) {
+			fprintf(stderr, "%s: can't resume %s: %s\n", argv[0],
+					resumePath, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	} else if (initGame(&game, &rules, level, seed, renderer,
+			input) != 0) {
+		fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+		return EXIT_FAILURE;
+	}
 
-int
-main(int argc, char *argv[])
-{
-	srand(time(NULL));
-	setCursorVisibility(0);
+	if (!headless) {
+		if (terminalBegin(rules.width, rules.height,
+				lowBandwidth ? LOW_BANDWIDTH : 0,
+				renderThread, broadcastAddress,
+				broadcastPort) != 0) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+			return EXIT_FAILURE;
+		}
+		usingTerminal = 1;
+	}
+	/* Being interrupted or killed saves the game first, if it is being
+	 * saved. */
+	if (usingTerminal || autosaving) {
+		signal(SIGINT, cleanup);
+		signal(SIGTERM, cleanup);
+	}
 
-	signal(SIGINT, cleanup);
+	playGame(&game);
 
-	int level = (argc > 1) ? atoi(argv[1]) : 1;
-	unsigned int score = 0;
-	int lives = STARTING_LIVES;
+	cleanup(0);
 
-	while (play(level, &score, &lives) > 0) {
-		showMessage("Level %d complete!\nPress any key to continue...", level);
-		anykey(NULL);
-		level++;
+#if INSTRUMENT
+	instrumentReport(stderr);
+#endif
+
+	int status = 0;
+	if (autosaving) {
+		/* The handler mustn't save a game that is being freed. */
+		autosaving = 0;
+		if (stopAutosave(&autosave) != 0) {
+			fprintf(stderr, "%s: can't save to %s: %s\n", argv[0],
+					savePath, strerror(errno));
+			status = EXIT_FAILURE;
+		}
+	}
+	if (recordPath != NULL && stopRecording(&recorder) != 0) {
+		fprintf(stderr, "%s: can't record to %s: %s\n", argv[0],
+				recordPath, strerror(errno));
+		status = EXIT_FAILURE;
+	}
+	if (replayPath != NULL) {
+		stopReplay(&replay);
 	}
 
-	/* When the program reaches this point, the player has ran out of
-	 * lives, and the game is over. */
-	showMessage("Game over!\nScore: %d\nLevel: %d\nPress any key to quit.",
-			score, level);
-	anykey(NULL);
-
-	cleanup(0);
+	if (headless) {
+		printf("seed %llu score %u level %d frames %lu "
+				"checksum %08lx\n", (unsigned long long)seed,
+				game.score, game.level, game.frames,
+				(unsigned long)checksumBoard(&game));
+	}
+	freeGame(&game);
+	if (levelsPath != NULL) {
+		closeLevelPack(&levels);
+	}
 
-	return 0;
+	/* Quitting on a signal is reported the same way whether or not the
+	 * game had to finish its frame first. */
+	if (status == 0 && quitSignal != 0) {
+		status = 128 + quitSignal;
+	}
+	return status;
 }
-
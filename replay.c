@@ -0,0 +1,407 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "replay.h"
+
+/*
+ * The first bytes of every recording, and the version of the format that
+ * follows them.
+ */
+static const char MAGIC[4] = { 'A', 'B', 'R', 'K' };
+static const int VERSION = 4;
+
+static void decodeControls(int bits, struct controls *controls);
+static int encodeControls(const struct controls *controls);
+static void readEvent(struct replay *replay);
+static int readVarint(FILE *file, unsigned long *value);
+static void recordAnykey(struct input *in);
+static unsigned long recordDue(struct input *in);
+static void recordRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void recordResume(struct input *in, unsigned long frame);
+static void recordWait(struct input *in, unsigned long frame);
+static void replayAnykey(struct input *in);
+static unsigned long replayDue(struct input *in);
+static void replayRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void replayResume(struct input *in, unsigned long frame);
+static void replayWait(struct input *in, unsigned long frame);
+static void writeVarint(FILE *file, unsigned long value);
+
+/*
+ * Fills in controls from the REPLAY_* bits of an event.
+ */
+static void
+decodeControls(int bits, struct controls *controls)
+{
+	controls->direction = 0;
+	if (bits & REPLAY_LEFT) {
+		controls->direction = -1;
+	} else if (bits & REPLAY_RIGHT) {
+		controls->direction = 1;
+	}
+	controls->togglePause = (bits & REPLAY_PAUSE) != 0;
+	controls->quit = (bits & REPLAY_QUIT) != 0;
+	controls->redraw = (bits & REPLAY_REDRAW) != 0;
+}
+
+/*
+ * Returns the REPLAY_* bits for controls, which are 0 if the player didn't do
+ * anything.
+ */
+static int
+encodeControls(const struct controls *controls)
+{
+	int bits = 0;
+
+	if (controls->direction < 0) {
+		bits |= REPLAY_LEFT;
+	} else if (controls->direction > 0) {
+		bits |= REPLAY_RIGHT;
+	}
+	if (controls->togglePause) {
+		bits |= REPLAY_PAUSE;
+	}
+	if (controls->quit) {
+		bits |= REPLAY_QUIT;
+	}
+	if (controls->redraw) {
+		bits |= REPLAY_REDRAW;
+	}
+	return bits;
+}
+
+/*
+ * Reads the next event of a replay. If there isn't one, the replay is marked
+ * as run out.
+ */
+static void
+readEvent(struct replay *replay)
+{
+	unsigned long delta;
+	int bits;
+
+	if (readVarint(replay->file, &delta) != 0
+			|| (bits = getc(replay->file)) == EOF) {
+		replay->next = 0;
+		return;
+	}
+	replay->next += delta;
+	replay->controls = bits;
+}
+
+/*
+ * Reads a varint from file into value. Returns 0 on success, or -1 if the
+ * file ends first.
+ */
+static int
+readVarint(FILE *file, unsigned long *value)
+{
+	int c;
+
+	*value = 0;
+	for (int shift = 0; (c = getc(file)) != EOF; shift += 7) {
+		if (shift < (int)(sizeof(*value) * 8)) {
+			*value |= (unsigned long)(c & 0x7f) << shift;
+		}
+		if ((c & 0x80) == 0) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static void
+recordAnykey(struct input *in)
+{
+	struct recorder *recorder = (struct recorder *)in;
+
+	recorder->source->anykey(recorder->source);
+}
+
+static unsigned long
+recordDue(struct input *in)
+{
+	struct recorder *recorder = (struct recorder *)in;
+
+	return recorder->source->due(recorder->source);
+}
+
+static void
+recordRead(struct input *in, struct controls *controls, unsigned long frame,
+		int isPaused)
+{
+	struct recorder *recorder = (struct recorder *)in;
+	int bits;
+
+	recorder->source->read(recorder->source, controls, frame, isPaused);
+
+	/* Frames without input aren't written down at all. */
+	if ((bits = encodeControls(controls)) != 0) {
+		writeVarint(recorder->file, frame - recorder->last);
+		putc(bits, recorder->file);
+		recorder->last = frame;
+	}
+}
+
+static void
+recordResume(struct input *in, unsigned long frame)
+{
+	struct recorder *recorder = (struct recorder *)in;
+
+	recorder->source->resume(recorder->source, frame);
+}
+
+static void
+recordWait(struct input *in, unsigned long frame)
+{
+	struct recorder *recorder = (struct recorder *)in;
+
+	recorder->source->wait(recorder->source, frame);
+}
+
+static void
+replayAnykey(struct input *in)
+{
+	struct replay *replay = (struct replay *)in;
+
+	replay->source->anykey(replay->source);
+}
+
+static unsigned long
+replayDue(struct input *in)
+{
+	struct replay *replay = (struct replay *)in;
+	unsigned long due = replay->source->due(replay->source);
+
+	/* The frame before the next event is as far as the game can go until
+	 * the event has been read. */
+	if (replay->next != 0 && due >= replay->next) {
+		due = replay->next - 1;
+	}
+	return due;
+}
+
+static void
+replayRead(struct input *in, struct controls *controls, unsigned long frame,
+		int isPaused)
+{
+	struct replay *replay = (struct replay *)in;
+
+	/* Whoever is watching can still quit, but everything else comes from
+	 * the recording. */
+	replay->source->read(replay->source, controls, frame, isPaused);
+	if (controls->quit) {
+		return;
+	}
+
+	decodeControls(0, controls);
+	if (replay->next != 0 && replay->next <= frame) {
+		decodeControls(replay->controls, controls);
+		readEvent(replay);
+	} else if (replay->next == 0 && isPaused) {
+		/* The recording ran out while the game was paused, so nothing
+		 * is ever going to happen again. */
+		controls->quit = 1;
+	}
+}
+
+static void
+replayResume(struct input *in, unsigned long frame)
+{
+	struct replay *replay = (struct replay *)in;
+
+	replay->source->resume(replay->source, frame);
+}
+
+static void
+replayWait(struct input *in, unsigned long frame)
+{
+	struct replay *replay = (struct replay *)in;
+	struct input *source = replay->source;
+
+	if (replay->next != 0 && (frame == 0 || frame >= replay->next)) {
+		/* The next event is the input being waited for, and it
+		 * arrives once the frame before it is due. */
+		if (source->due(source) >= replay->next - 1) {
+			return;
+		}
+		frame = replay->next - 1;
+	} else if (replay->next == 0 && frame == 0) {
+		/* There is nothing left to wait for. */
+		return;
+	}
+	source->wait(source, frame);
+}
+
+/*
+ * Starts recording the game that is about to be played with the given seed,
+ * level and rules, using input from source, to the file at path. Returns 0 on
+ * success, or -1 with errno set if the file can't be written.
+ */
+int
+startRecording(struct recorder *recorder, struct input *source,
+		const char *path, uint64_t seed, int level,
+		const struct rules *rules)
+{
+	if ((recorder->file = fopen(path, "wb")) == NULL) {
+		return -1;
+	}
+
+	fwrite(MAGIC, 1, sizeof(MAGIC), recorder->file);
+	putc(VERSION, recorder->file);
+	for (int i = 0; i < 8; i++) {
+		putc((int)(seed >> (8 * i)) & 0xff, recorder->file);
+	}
+	writeVarint(recorder->file, (unsigned long)level);
+	writeVarint(recorder->file, (unsigned long)rules->width);
+	writeVarint(recorder->file, (unsigned long)rules->height);
+	writeVarint(recorder->file, (unsigned long)rules->balls);
+	putc(rules->multiball ? 1 : 0, recorder->file);
+	if (ferror(recorder->file)) {
+		int saved = errno;
+		fclose(recorder->file);
+		errno = saved;
+		return -1;
+	}
+
+	recorder->input.due = recordDue;
+	recorder->input.wait = recordWait;
+	recorder->input.read = recordRead;
+	recorder->input.resume = recordResume;
+	recorder->input.anykey = recordAnykey;
+	recorder->source = source;
+	recorder->last = 0;
+	return 0;
+}
+
+/*
+ * Opens the recording at path to be played back, with the clock coming from
+ * source, and reads the seed and level that the game started with and the
+ * size of its board. Returns 0 on success, or -1 with errno set if the file
+ * can't be read or isn't a recording.
+ */
+int
+startReplay(struct replay *replay, struct input *source, const char *path,
+		uint64_t *seed, int *level, struct rules *rules)
+{
+	char magic[sizeof(MAGIC)];
+	unsigned long startLevel, boardWidth, boardHeight, balls;
+	int c, version, multiball;
+
+	if ((replay->file = fopen(path, "rb")) == NULL) {
+		return -1;
+	}
+
+	*seed = 0;
+	if (fread(magic, 1, sizeof(magic), replay->file) != sizeof(magic)
+			|| memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		goto invalid;
+	}
+	if ((version = getc(replay->file)) < 3 || version > VERSION) {
+		goto invalid;
+	}
+	for (int i = 0; i < 8; i++) {
+		if ((c = getc(replay->file)) == EOF) {
+			goto invalid;
+		}
+		*seed |= (uint64_t)c << (8 * i);
+	}
+	if (readVarint(replay->file, &startLevel) != 0 || startLevel < 1
+			|| startLevel > MAX_LEVEL) {
+		goto invalid;
+	}
+	*level = (int)startLevel;
+	if (readVarint(replay->file, &boardWidth) != 0
+			|| readVarint(replay->file, &boardHeight) != 0) {
+		goto invalid;
+	}
+	balls = 1;
+	multiball = 0;
+	if (version >= 4 && (readVarint(replay->file, &balls) != 0
+			|| (multiball = getc(replay->file)) == EOF)) {
+		goto invalid;
+	}
+	if (boardWidth > MAX_WIDTH || boardHeight > MAX_HEIGHT
+			|| balls > MAX_BALLS) {
+		goto invalid;
+	}
+	rules->width = (int)boardWidth;
+	rules->height = (int)boardHeight;
+	rules->balls = (int)balls;
+	rules->multiball = multiball != 0;
+
+	replay->input.due = replayDue;
+	replay->input.wait = replayWait;
+	replay->input.read = replayRead;
+	replay->input.resume = replayResume;
+	replay->input.anykey = replayAnykey;
+	replay->source = source;
+	replay->next = 0;
+	readEvent(replay);
+	return 0;
+
+invalid:
+	fclose(replay->file);
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Finishes a recording. Returns 0 on success, or -1 with errno set if any of
+ * it couldn't be written.
+ */
+int
+stopRecording(struct recorder *recorder)
+{
+	int failed = ferror(recorder->file);
+
+	if (fclose(recorder->file) != 0) {
+		return -1;
+	}
+	if (failed) {
+		errno = EIO;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Closes a recording that was being played back.
+ */
+void
+stopReplay(struct replay *replay)
+{
+	fclose(replay->file);
+}
+
+/*
+ * Writes value to file as a varint.
+ */
+static void
+writeVarint(FILE *file, unsigned long value)
+{
+	do {
+		int c = value & 0x7f;
+		value >>= 7;
+		putc(value != 0 ? c | 0x80 : c, file);
+	} while (value != 0);
+}
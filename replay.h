@@ -0,0 +1,108 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Recording games and playing them back. A recording is the seed and starting
+ * level of a game, followed by every frame on which the player did something.
+ * Since the game is deterministic, that is enough to play the whole thing out
+ * again exactly.
+ *
+ * The file starts with a header:
+ *
+ *	4 bytes		"ABRK"
+ *	1 byte		version (4)
+ *	8 bytes		seed, least significant byte first
+ *	varint		starting level
+ *	varint		width of the board
+ *	varint		height of the board
+ *	varint		balls at the start of each life
+ *	1 byte		1 if multiball is on, otherwise 0
+ *
+ * (Version 3 recordings stop after the height, and were all played with one
+ * ball and no multiball. Recordings from older versions can't be played back,
+ * since the ball moved differently then, and the same input wouldn't lead to
+ * the same game.)
+ *
+ * followed by one event for each frame with input:
+ *
+ *	varint		frames since the last event (or since frame 0)
+ *	1 byte		controls, as REPLAY_* bits
+ *
+ * A varint is 7 bits per byte, least significant group first, with the high
+ * bit set on every byte but the last. Most events fit in 2 bytes.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+/*
+ * The bits of the controls byte in an event.
+ */
+enum {
+	REPLAY_LEFT = 1 << 0,
+	REPLAY_RIGHT = 1 << 1,
+	REPLAY_PAUSE = 1 << 2,
+	REPLAY_QUIT = 1 << 3,
+	REPLAY_REDRAW = 1 << 4,
+};
+
+/*
+ * An input that passes everything through from source, writing down the
+ * controls as it goes.
+ */
+struct recorder {
+	struct input input;
+	struct input *source;
+	FILE *file;
+
+	/* The frame of the last event written. */
+	unsigned long last;
+};
+
+/*
+ * An input that plays back a recording. The clock still comes from source,
+ * so a replay runs in real time in the terminal, or as fast as it can
+ * headless, but it never runs past the next recorded event before it has
+ * been read.
+ */
+struct replay {
+	struct input input;
+	struct input *source;
+	FILE *file;
+
+	/* The frame of the next event, and its controls. next is 0 once the
+	 * recording has run out. */
+	unsigned long next;
+	int controls;
+};
+
+int startRecording(struct recorder *recorder, struct input *source,
+		const char *path, uint64_t seed, int level,
+		const struct rules *rules);
+int startReplay(struct replay *replay, struct input *source,
+		const char *path, uint64_t *seed, int *level,
+		struct rules *rules);
+int stopRecording(struct recorder *recorder);
+void stopReplay(struct replay *replay);
+
+#endif /* REPLAY_H */
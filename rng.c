@@ -0,0 +1,77 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rng.h"
+
+static uint64_t rotl(uint64_t x, int k);
+
+/*
+ * Returns the next 64 random bits.
+ */
+uint64_t
+rngNext(struct rng *rng)
+{
+	uint64_t *s = rng->s;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+/*
+ * Returns a random number from 0 to n - 1.
+ */
+int
+rngRange(struct rng *rng, int n)
+{
+	/* The top 32 bits are the best ones, and scaling them (rather than
+	 * taking a remainder) keeps the result evenly spread. */
+	return (int)(((rngNext(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+/*
+ * Seeds rng. The state is filled in from the seed using splitmix64, which
+ * gives good starting states even for seeds that are close together, like
+ * 1, 2, 3...
+ */
+void
+rngSeed(struct rng *rng, uint64_t seed)
+{
+	for (int i = 0; i < 4; i++) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		rng->s[i] = z ^ (z >> 31);
+	}
+}
+
+/*
+ * Rotates x left by k bits.
+ */
+static uint64_t
+rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
@@ -48,6 +48,8 @@
 	#include <sstream>
 	#include <cstdio> /* for getch() */
 	#include <cstdarg> /* for colorPrint() */
+	#include <cstring> /* for memcpy() */
+	#include <cstdlib> /* for locateCache() */
 
 	/* Namespace forward declarations */
 	namespace rogueutil
@@ -56,7 +58,8 @@
         }
 #else
 	#include <stdio.h> /* for getch() / printf() */
-	#include <string.h> /* for strlen() */
+	#include <string.h> /* for strlen() and memcpy() */
+	#include <stdlib.h> /* for locateCache() */
 	#include <stdarg.h> /* for colorPrint() */
 
 	void locate(int x, int y); /* Forward declare for C to avoid warnings */
@@ -76,11 +79,159 @@
 	#include <sys/ioctl.h> /* for getkey() */
 	#include <sys/types.h> /* for kbhit() */
 	#include <sys/time.h> /* for kbhit() */
+	#include <errno.h> /* for rutil_flush() */
+	#include <poll.h> /* for nb_getch() */
 #endif
 
+/**
+ * @brief Size in bytes of the output buffer
+ * @details Output is collected in a buffer and written to the terminal all at
+ * once by rutil_flush(), or when the buffer fills up. Output from printf() and
+ * friends does not go through this buffer. Define before including rogueutil
+ * to override.
+ */
+#ifndef RUTIL_BUFFER_SIZE
+	#define RUTIL_BUFFER_SIZE 65536
+#endif /* RUTIL_BUFFER_SIZE */
+
+/**
+ * @brief Called after each system call made to read or write the terminal
+ * @details written is how many bytes the call wrote, or 0 if it didn't write
+ * any. Define before including rogueutil to count them.
+ */
+#ifndef RUTIL_SYSCALL
+	#define RUTIL_SYSCALL(written) ((void)0)
+#endif /* RUTIL_SYSCALL */
+
+/**
+ * @brief Called with everything the output buffer holds, just before it is
+ * written out
+ * @details Define before including rogueutil to send a copy of the output
+ * somewhere else too.
+ */
+#ifndef RUTIL_OUTPUT
+	#define RUTIL_OUTPUT(buf, len) ((void)0)
+#endif /* RUTIL_OUTPUT */
+
+static char rutil_buffer[RUTIL_BUFFER_SIZE];
+static size_t rutil_buffered = 0;
+
+/**
+ * @brief Writes out everything in the output buffer
+ */
+void
+rutil_flush(void)
+{
+#ifdef _WIN32
+	fwrite(rutil_buffer, 1, rutil_buffered, stdout);
+	fflush(stdout);
+#else
+	size_t done = 0;
+	RUTIL_OUTPUT(rutil_buffer, rutil_buffered);
+	while (done < rutil_buffered) {
+		ssize_t n = write(STDOUT_FILENO, rutil_buffer + done,
+				rutil_buffered - done);
+		RUTIL_SYSCALL(n > 0 ? n : 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		done += (size_t)n;
+	}
+#endif /* _WIN32 */
+	rutil_buffered = 0;
+}
+
+/**
+ * @brief Appends len bytes of s to the output buffer
+ * @see rutil_flush()
+ */
+static void
+rutil_write(const char *s, size_t len)
+{
+	while (len > 0) {
+		size_t n = RUTIL_BUFFER_SIZE - rutil_buffered;
+		if (n == 0) {
+			rutil_flush();
+			continue;
+		}
+		if (n > len)
+			n = len;
+		memcpy(rutil_buffer + rutil_buffered, s, n);
+		rutil_buffered += n;
+		s += n;
+		len -= n;
+	}
+}
+
 /* Functions covered by Window's conio.h */
 #ifndef _WIN32
 
+/* Whether setRawMode() has put the terminal in raw mode, and the settings to
+ * put back when it is taken out of it. */
+static int rutil_raw = 0;
+static struct termios rutil_cooked;
+
+/**
+ * @brief Puts the terminal in raw mode, or takes it back out
+ * @details In raw mode input is not echoed or line-buffered, and getch(),
+ * kbhit() and nb_getch() read from the terminal as it is instead of changing
+ * its settings on every call. Signals like ^C still work.
+ * @param enable 1 to enter raw mode, 0 to restore the previous settings
+ * @return 0 on success, -1 on error
+ */
+int
+setRawMode(int enable)
+{
+	struct termios raw;
+
+	if (!enable) {
+		if (rutil_raw
+				&& tcsetattr(STDIN_FILENO, TCSANOW, &rutil_cooked) < 0)
+			return -1;
+		rutil_raw = 0;
+		return 0;
+	}
+
+	if (rutil_raw)
+		return 0;
+	if (tcgetattr(STDIN_FILENO, &rutil_cooked) < 0)
+		return -1;
+	raw = rutil_cooked;
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_cc[VMIN]  = 1; /* getch() blocks for one character */
+	raw.c_cc[VTIME] = 0; /* with no timeout */
+	if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) < 0)
+		return -1;
+	rutil_raw = 1;
+	return 0;
+}
+
+/**
+ * @brief Reads up to len bytes of input without blocking (raw mode only)
+ * @return The number of bytes read, 0 if none were waiting, or -1 at the end
+ * of the input (or if it can't be read)
+ */
+static int
+rutil_readPending(char *buf, int len)
+{
+	struct pollfd p;
+	ssize_t n;
+
+	p.fd = STDIN_FILENO;
+	p.events = POLLIN;
+	n = poll(&p, 1, 0);
+	RUTIL_SYSCALL(0);
+	if (n <= 0 || !(p.revents & (POLLIN | POLLHUP | POLLERR)))
+		return 0;
+	n = read(STDIN_FILENO, buf, len);
+	RUTIL_SYSCALL(0);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN))
+		return 0;
+	return n > 0 ? (int)n : -1;
+}
+
 /**
  * @brief Get a charater without waiting on a Return
  * @details Windows has this functionality in conio.h
@@ -91,6 +242,14 @@ getch(void)
 {
 	struct termios oldt, newt;
 	int ch;
+	rutil_flush(); /* Show pending output before waiting for input */
+	if (rutil_raw) {
+		unsigned char c;
+		ssize_t n;
+		while ((n = read(STDIN_FILENO, &c, 1)) < 0 && errno == EINTR)
+			;
+		return n == 1 ? c : EOF;
+	}
 	tcgetattr(STDIN_FILENO, &oldt);
 	newt = oldt;
 	newt.c_lflag &= ~(ICANON | ECHO);
@@ -110,6 +269,10 @@ kbhit(void)
 {
 	static struct termios oldt, newt;
 	int cnt = 0;
+	if (rutil_raw) {
+		ioctl(STDIN_FILENO, FIONREAD, &cnt);
+		return cnt;
+	}
 	tcgetattr(STDIN_FILENO, &oldt);
 	newt = oldt;
 	newt.c_lflag    &= ~(ICANON | ECHO);
@@ -222,6 +385,30 @@ static const RUTIL_STRING ANSI_BACKGROUND_CYAN    = "\033[46m";
 static const RUTIL_STRING ANSI_BACKGROUND_WHITE   = "\033[47m";
 /* Remaining colors not supported as background colors */
 
+/**
+ * @brief Colors the terminal is currently using
+ * @details Kept up to date by setColor(), setBackgroundColor(), setColors()
+ * and resetColor() so that they only send a sequence when the colors actually
+ * change. -1 is the default color and RUTIL_ATTR_UNKNOWN means the color is
+ * not known, as is the case at startup.
+ */
+#define RUTIL_ATTR_UNKNOWN (-2)
+static int rutil_fg = RUTIL_ATTR_UNKNOWN;
+static int rutil_bg = RUTIL_ATTR_UNKNOWN;
+
+/**
+ * @brief Cursor-positioning sequences built ahead of time by locateCache()
+ * @details Every sequence is split into a part for its row, "\033[y;", and a
+ * part for its column, "xf", so that there are only width + height of them to
+ * keep. Each part takes RUTIL_LOCATE_PART bytes: its length, then the part
+ * itself. Part n of each array is for row or column n.
+ */
+#define RUTIL_LOCATE_PART 12
+static char *rutil_locateRows = NULL;
+static char *rutil_locateColumns = NULL;
+static int rutil_locateWidth = 0;
+static int rutil_locateHeight = 0;
+
 /**
  * @brief Provides keycodes for special keys
  */
@@ -278,9 +465,9 @@ static void
 rutil_print(RUTIL_STRING st)
 {
 #ifdef __cplusplus
-        std::cout << st;
+        rutil_write(st.data(), st.size());
 #else
-        printf("%s", st);
+        rutil_write(st, strlen(st));
 #endif
 }
 
@@ -389,10 +576,63 @@ getkey(void)
 int
 nb_getch(void)
 {
+#ifndef _WIN32
+	if (rutil_raw) {
+		char c;
+		return rutil_readPending(&c, 1) > 0 ? (unsigned char)c : 0;
+	}
+#endif /* _WIN32 */
 	if (kbhit()) return getch();
 	else return 0;
 }
 
+/**
+ * @brief Waits until there is input to read, for at most timeout milliseconds
+ * @param timeout How long to wait in milliseconds, or -1 to wait forever
+ * @return 1 if there is input waiting (or the end of the input has been
+ * reached), or 0 if the wait timed out or was interrupted by a signal
+ */
+int
+kbwait(int timeout)
+{
+#ifdef _WIN32
+	return WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE),
+			timeout < 0 ? INFINITE : (DWORD)timeout) == WAIT_OBJECT_0;
+#else
+	struct pollfd p;
+	int ready;
+
+	p.fd = STDIN_FILENO;
+	p.events = POLLIN;
+	ready = poll(&p, 1, timeout) > 0
+		&& (p.revents & (POLLIN | POLLHUP | POLLERR));
+	RUTIL_SYSCALL(0);
+	return ready;
+#endif /* _WIN32 */
+}
+
+/**
+ * @brief Reads all of the input that is waiting, up to len bytes, without
+ * blocking
+ * @details In raw mode this takes a single read().
+ * @return The number of bytes read into buf, or -1 at the end of the input (in
+ * raw mode only)
+ * @see nb_getch()
+ * @see setRawMode()
+ */
+int
+nb_read(char *buf, int len)
+{
+	int n = 0, ch;
+#ifndef _WIN32
+	if (rutil_raw)
+		return rutil_readPending(buf, len);
+#endif /* _WIN32 */
+	while (n < len && (ch = nb_getch()) != 0)
+		buf[n++] = (char)ch;
+	return n;
+}
+
 /**
  * @brief Returns ANSI color escape sequence for specified number
  * @param c Number 0-15 corresponding to the color code
@@ -485,7 +725,10 @@ setColor(int c)
 
 	SetConsoleTextAttribute(hConsole, (csbi.wAttributes & 0xFFF0) | (WORD)c); // Foreground colors take up the least significant byte
 #else
+	if (c == rutil_fg)
+		return;
 	rutil_print(getANSIColor(c));
+	rutil_fg = c;
 #endif
 }
 
@@ -505,7 +748,10 @@ setBackgroundColor(int c)
 
 	SetConsoleTextAttribute(hConsole, (csbi.wAttributes & 0xFF0F) | (((WORD)c) << 4)); // Background colors take up the second-least significant byte
 #else
+	if (c == rutil_bg)
+		return;
 	rutil_print(getANSIBgColor(c));
+	rutil_bg = c;
 #endif
 }
 
@@ -544,7 +790,81 @@ resetColor(void)
 #if defined(_WIN32) && !defined(RUTIL_USE_ANSI)
 	SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), (WORD)saveDefaultColor());
 #else
+	if (rutil_fg == -1 && rutil_bg == -1)
+		return;
 	rutil_print(ANSI_ATTRIBUTE_RESET);
+	rutil_fg = -1;
+	rutil_bg = -1;
+#endif
+}
+
+/**
+ * @brief Appends the parameters of an SGR sequence to buf
+ * @details The parameters are the part between "\033[" and "m", and are
+ * preceded by a ';' if buf already has some in it.
+ * @return The new length of buf
+ */
+static size_t
+rutil_sgrParams(char *buf, size_t len, RUTIL_STRING seq)
+{
+#ifdef __cplusplus
+	const char *s = seq.c_str();
+#else
+	const char *s = seq;
+#endif /* __cplusplus */
+	size_t n = strlen(s);
+
+	if (n < 3)
+		return len; /* Unsupported color */
+	if (len > 2)
+		buf[len++] = ';';
+	memcpy(buf + len, s + 2, n - 3);
+	return len + n - 3;
+}
+
+/**
+ * @brief Changes both the foreground and background color at once
+ * @details Only what actually changes is sent, all in a single sequence.
+ * @param fg Foreground color code, or -1 for the default color
+ * @param bg Background color code, or -1 for the default color
+ * @see color_code
+ * @see setColor()
+ * @see setBackgroundColor()
+ */
+void
+setColors(int fg, int bg)
+{
+#if defined(_WIN32) && !defined(RUTIL_USE_ANSI)
+	resetColor();
+	if (fg >= 0)
+		setColor(fg);
+	if (bg >= 0)
+		setBackgroundColor(bg);
+#else
+	/* Long enough for a reset and both colors. */
+	char buf[32] = "\033[";
+	size_t len = 2;
+
+	if (fg == rutil_fg && bg == rutil_bg)
+		return;
+
+	/* There are no sequences for going back to the default colors here,
+	 * so start from a reset instead. */
+	if ((fg < 0 && fg != rutil_fg) || (bg < 0 && bg != rutil_bg)
+			|| rutil_fg == RUTIL_ATTR_UNKNOWN
+			|| rutil_bg == RUTIL_ATTR_UNKNOWN) {
+		buf[len++] = '0';
+		rutil_fg = -1;
+		rutil_bg = -1;
+	}
+	if (fg >= 0 && fg != rutil_fg)
+		len = rutil_sgrParams(buf, len, getANSIColor(fg));
+	if (bg >= 0 && bg != rutil_bg)
+		len = rutil_sgrParams(buf, len, getANSIBgColor(bg));
+	buf[len++] = 'm';
+	rutil_write(buf, len);
+	rutil_fg = fg;
+	rutil_bg = bg;
 #endif
 }
 
@@ -587,6 +907,16 @@ locate(int x, int y)
 	coord.Y = (SHORT)(y - 1); /* Windows uses 0-based coordinates */
 	SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), coord);
 #else /* _WIN32 || USE_ANSI */
+	if (x >= 1 && x <= rutil_locateWidth && y >= 1
+			&& y <= rutil_locateHeight) {
+		const char *row = rutil_locateRows
+			+ (size_t)y * RUTIL_LOCATE_PART;
+		const char *column = rutil_locateColumns
+			+ (size_t)x * RUTIL_LOCATE_PART;
+		rutil_write(row + 1, (unsigned char)row[0]);
+		rutil_write(column + 1, (unsigned char)column[0]);
+		return;
+	}
 #ifdef __cplusplus
         std::stringstream ss;
         ss << "\033[" << y << ";" << x << "H";
@@ -599,6 +929,55 @@ locate(int x, int y)
 #endif /* _WIN32 || USE_ANSI */
 }
 
+/**
+ * @brief Builds the sequences for locate() to go to any position up to (width, height)
+ * @details After this, locate() copies its sequence out of a table instead of
+ * formatting it every time. Positions outside of the table still work, they
+ * are just formatted. Calling this again replaces the table.
+ * @return 0 on success, or -1 if there isn't enough memory for the table, in
+ * which case locate() formats every sequence
+ */
+int
+locateCache(int width, int height)
+{
+#if defined(_WIN32) && !defined(RUTIL_USE_ANSI)
+	(void)width;
+	(void)height;
+	return 0;
+#else
+	free(rutil_locateRows);
+	free(rutil_locateColumns);
+	rutil_locateWidth = 0;
+	rutil_locateHeight = 0;
+	rutil_locateRows = (char *)malloc((size_t)(height + 1)
+			* RUTIL_LOCATE_PART);
+	rutil_locateColumns = (char *)malloc((size_t)(width + 1)
+			* RUTIL_LOCATE_PART);
+	if (rutil_locateRows == NULL || rutil_locateColumns == NULL) {
+		free(rutil_locateRows);
+		free(rutil_locateColumns);
+		rutil_locateRows = NULL;
+		rutil_locateColumns = NULL;
+		return -1;
+	}
+
+	for (int y = 1; y <= height; y++) {
+		char *row = rutil_locateRows + (size_t)y * RUTIL_LOCATE_PART;
+		row[0] = (char)snprintf(row + 1, RUTIL_LOCATE_PART - 1,
+				"\033[%d;", y);
+	}
+	for (int x = 1; x <= width; x++) {
+		char *column = rutil_locateColumns
+			+ (size_t)x * RUTIL_LOCATE_PART;
+		column[0] = (char)snprintf(column + 1, RUTIL_LOCATE_PART - 1,
+				"%df", x);
+	}
+	rutil_locateWidth = width;
+	rutil_locateHeight = height;
+	return 0;
+#endif /* _WIN32 || USE_ANSI */
+}
+
 /**
  * @brief Prints the supplied string without advancing the cursor
  */
@@ -640,6 +1019,13 @@ setString(RUTIL_STRING str)
 #else
 	char buf[3 + 20 + 1]; /* 20 = max length of 64-bit
                                  * unsigned int when printed as dec */
+	if (len < 10) {
+		/* Short strings are the common case, and need just the one
+		 * digit. */
+		const char back[] = {'\033', '[', (char)('0' + len), 'D'};
+		rutil_write(back, sizeof(back));
+		return;
+	}
 	sprintf(buf, "\033[%uD", len);
 	rutil_print(buf);
 #endif /* __cplusplus */
@@ -715,7 +1101,8 @@ msleep(unsigned int ms)
 }
 
 /**
- * @brief Returns the number of rows in the terminal window or -1 on error.
+ * @brief Returns the number of rows in the terminal window, or -1 if it
+ * isn't known.
  */
 int
 trows(void)
@@ -728,12 +1115,14 @@ trows(void)
 		return csbi.srWindow.Bottom - csbi.srWindow.Top + 1; // Window height
 #else
 #ifdef TIOCGSIZE
-	struct ttysize ts;
-	ioctl(STDIN_FILENO, TIOCGSIZE, &ts);
+	struct ttysize ts = {0};
+	if (ioctl(STDIN_FILENO, TIOCGSIZE, &ts) < 0 || ts.ts_lines == 0)
+		return -1;
 	return ts.ts_lines;
 #elif defined(TIOCGWINSZ)
-	struct winsize ts;
-	ioctl(STDIN_FILENO, TIOCGWINSZ, &ts);
+	struct winsize ts = {0};
+	if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ts) < 0 || ts.ws_row == 0)
+		return -1;
 	return ts.ws_row;
 #else /* TIOCGSIZE */
 	return -1;
@@ -742,7 +1131,8 @@ trows(void)
 }
 
 /**
- * @brief Returns the number of columns in the terminal or -1 on error.
+ * @brief Returns the number of columns in the terminal, or -1 if it isn't
+ * known.
  */
 int
 tcols(void)
@@ -755,12 +1145,14 @@ tcols(void)
 		return csbi.srWindow.Right - csbi.srWindow.Left + 1; // Window width
 #else
 #ifdef TIOCGSIZE
-	struct ttysize ts;
-	ioctl(STDIN_FILENO, TIOCGSIZE, &ts);
+	struct ttysize ts = {0};
+	if (ioctl(STDIN_FILENO, TIOCGSIZE, &ts) < 0 || ts.ts_cols == 0)
+		return -1;
 	return ts.ts_cols;
 #elif defined(TIOCGWINSZ)
-	struct winsize ts;
-	ioctl(STDIN_FILENO, TIOCGWINSZ, &ts);
+	struct winsize ts = {0};
+	if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ts) < 0 || ts.ws_col == 0)
+		return -1;
 	return ts.ws_col;
 #else /* TIOCGSIZE */
 	return -1;
@@ -776,6 +1168,7 @@ tcols(void)
 void
 anykey()
 {
+	rutil_flush();
 	getch();
 }
 
@@ -791,6 +1184,7 @@ anykey(RUTIL_STRING msg)
 	if (msg)
 		rutil_print(msg);
 #endif /* __cplusplus */
+	rutil_flush();
 	getch();
 }
 
@@ -839,7 +1233,9 @@ colorPrint(color_code color, color_code bgcolor, T arg, F... fmt)
 	if (bgcolor >= 0)
 		setBackgroundColor(bgcolor);
 
-	std::cout << arg << " "; /* Let me know if I should remove the space */
+	std::stringstream ss;
+	ss << arg << " "; /* Let me know if I should remove the space */
+	rutil_print(ss.str());
 	colorPrint(color, fmt...);
 }
 #else
@@ -855,7 +1251,10 @@ colorPrint(color_code color, color_code bgcolor, const char *fmt, ...)
 	if (bgcolor >= 0)
 		setBackgroundColor(bgcolor);
 
+	/* Keep the formatted text in order with the buffered output. */
+	rutil_flush();
         vprintf(fmt, args);
+	fflush(stdout);
 	va_end(args);
 
 	resetColor();
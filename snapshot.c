@@ -0,0 +1,491 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "term.h"
+
+/*
+ * The first bytes of every snapshot, and the version of the layout that
+ * follows them.
+ */
+static const char MAGIC[4] = { 'A', 'B', 'S', 'V' };
+static const uint32_t VERSION = 1;
+
+/*
+ * Ten seconds.
+ */
+const long long AUTOSAVE_INTERVAL = 10000000000LL;
+
+static void autosaveAnykey(struct input *in);
+static unsigned long autosaveDue(struct input *in);
+static void autosaveRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void autosaveResume(struct input *in, unsigned long frame);
+static void autosaveWait(struct input *in, unsigned long frame);
+static int isPlayable(const struct game *game);
+static void saveInBackground(struct autosave *autosave);
+static int saveNow(struct autosave *autosave);
+static void settle(struct autosave *autosave);
+static int waitForChild(struct autosave *autosave, int block);
+
+static void
+autosaveAnykey(struct input *in)
+{
+	struct autosave *autosave = (struct autosave *)in;
+
+	/* A game that is being quit doesn't wait for anybody. */
+	settle(autosave);
+	if (!autosave->stopping) {
+		autosave->source->anykey(autosave->source);
+	}
+	autosave->settled = 0;
+}
+
+static unsigned long
+autosaveDue(struct input *in)
+{
+	struct autosave *autosave = (struct autosave *)in;
+
+	return autosave->source->due(autosave->source);
+}
+
+static void
+autosaveRead(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused)
+{
+	struct autosave *autosave = (struct autosave *)in;
+
+	settle(autosave);
+	autosave->source->read(autosave->source, controls, frame, isPaused);
+	if (autosave->stopping) {
+		controls->quit = 1;
+	} else if (controls->quit) {
+		/* The game is saved as it was just before the player quit. */
+		autosave->error = saveNow(autosave) != 0 ? errno : 0;
+	} else if (monotonicTime() - autosave->last >= AUTOSAVE_INTERVAL) {
+		saveInBackground(autosave);
+	}
+	autosave->settled = 0;
+}
+
+static void
+autosaveResume(struct input *in, unsigned long frame)
+{
+	struct autosave *autosave = (struct autosave *)in;
+
+	autosave->source->resume(autosave->source, frame);
+}
+
+static void
+autosaveWait(struct input *in, unsigned long frame)
+{
+	struct autosave *autosave = (struct autosave *)in;
+
+	settle(autosave);
+	if (!autosave->stopping) {
+		autosave->source->wait(autosave->source, frame);
+	}
+	autosave->settled = 0;
+}
+
+/*
+ * Frees the arena of a snapshot read with loadSnapshot().
+ */
+void
+freeSnapshot(struct snapshot *snapshot)
+{
+	free(snapshot->arena);
+	snapshot->arena = NULL;
+}
+
+/*
+ * Returns whether the level in game's arena, as read from a snapshot, can be
+ * played on: whether every tile is a tile, and the paddle and every ball are on
+ * the board and move the way they can in a game. Nothing in the game checks
+ * these again, so a damaged snapshot would have it reading and writing past
+ * the end of the board.
+ */
+static int
+isPlayable(const struct game *game)
+{
+	const struct paddle *paddle = game->paddle;
+	const struct balls *balls = &game->balls;
+
+	for (size_t i = 0; i < (size_t)game->width * game->height; i++) {
+		if (game->board[i] > GREEN_BLOCK) {
+			return 0;
+		}
+	}
+	if (paddle->len < 1 || paddle->x < 0
+			|| paddle->x > game->width - paddle->len
+			|| paddle->y < 0 || paddle->y >= game->height
+			|| paddle->velocity < 1) {
+		return 0;
+	}
+	for (int i = 0; i < balls->count; i++) {
+		if (balls->x[i] < 0 || balls->x[i] >= game->width
+				|| balls->y[i] < 0
+				|| balls->y[i] >= game->height
+				|| balls->fx[i] >> FIXED_SHIFT != balls->x[i]
+				|| balls->fy[i] >> FIXED_SHIFT != balls->y[i]
+				|| balls->dx[i] == 0 || balls->dy[i] == 0
+				|| abs(balls->dx[i]) >= FIXED_ONE
+				|| abs(balls->dy[i]) >= FIXED_ONE) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Reads the snapshot saved at path into snapshot. Returns 0 on success, or -1
+ * with errno set if it can't be read, or EINVAL if it isn't a snapshot from
+ * this version of the game. The snapshot must be freed with freeSnapshot().
+ */
+int
+loadSnapshot(struct snapshot *snapshot, const char *path)
+{
+	struct snapshotHeader *header = &snapshot->header;
+	FILE *file;
+
+	snapshot->arena = NULL;
+	if ((file = fopen(path, "rb")) == NULL) {
+		return -1;
+	}
+	if (fread(header, sizeof(*header), 1, file) != 1
+			|| memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header->version != VERSION
+			|| header->arenaSize == 0
+			|| (size_t)header->arenaSize != header->arenaSize) {
+		goto invalid;
+	}
+	if ((snapshot->arena = malloc(header->arenaSize)) == NULL) {
+		fclose(file);
+		errno = ENOMEM;
+		return -1;
+	}
+	if (fread(snapshot->arena, 1, header->arenaSize, file)
+			!= header->arenaSize || getc(file) != EOF) {
+		goto invalid;
+	}
+	fclose(file);
+	return 0;
+
+invalid:
+	freeSnapshot(snapshot);
+	fclose(file);
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ * Sets up game to carry on from snapshot, as initGame() would set up a new
+ * game, with the boards of the levels after the one saved coming from levels
+ * (or being random, if it is NULL). The game picks up at the start of the
+ * frame after the one saved, once the player has pressed a key. Returns 0 on
+ * success, or -1 with errno set if there isn't enough memory, or EINVAL if the
+ * snapshot doesn't make sense. The game must be freed with freeGame().
+ */
+int
+resumeGame(struct game *game, const struct snapshot *snapshot,
+		const struct levelPack *levels, struct renderer *renderer,
+		struct input *input)
+{
+	const struct snapshotHeader *header = &snapshot->header;
+	const struct rules rules = {
+		header->width, header->height, header->balls,
+		header->multiball, levels
+	};
+
+	/* The paddle and board for the level are laid out from its number,
+	 * before there is anything to check them against. */
+	if (header->level < 1 || header->level > MAX_LEVEL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (initGame(game, &rules, header->level, header->seed, renderer,
+			input) != 0) {
+		return -1;
+	}
+	/* The arena is laid out the same way every time, so a snapshot from
+	 * a game with the same rules fills it exactly. */
+	if (header->arenaSize != game->arena.used || header->lives < 1
+			|| header->ballCount < 1
+			|| header->ballCount > MAX_BALLS
+			|| header->blockCount < 1) {
+		freeGame(game);
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(game->arena.base, snapshot->arena, header->arenaSize);
+	game->balls.count = header->ballCount;
+	if (!isPlayable(game)) {
+		freeGame(game);
+		errno = EINVAL;
+		return -1;
+	}
+	game->lives = header->lives;
+	game->score = header->score;
+	game->lifeFrames = header->lifeFrames;
+	game->blockCount = header->blockCount;
+	game->frames = header->frames;
+	game->blocksDestroyed = header->blocksDestroyed;
+	memcpy(game->rng.s, header->rng, sizeof(game->rng.s));
+	game->resumed = 1;
+	return 0;
+}
+
+/*
+ * Saves the game from a child process, so that the game can go on while the
+ * snapshot is written. If the last one is still being written, this one is
+ * skipped; there will be another one soon enough.
+ */
+static void
+saveInBackground(struct autosave *autosave)
+{
+	if (!waitForChild(autosave, 0)) {
+		return;
+	}
+	autosave->last = monotonicTime();
+
+	/* The child has a copy of the game as it is now, which is left alone
+	 * while the game goes on changing its own. */
+	pid_t pid = fork();
+	if (pid == 0) {
+		/* The signals that save the game are for the game, not this.
+		 * If one comes, the game will be saved again anyway. */
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		_exit(saveSnapshot(autosave->game, autosave->path,
+				autosave->tmpPath) == 0 ? 0 : EXIT_FAILURE);
+	}
+	if (pid < 0) {
+		saveSnapshot(autosave->game, autosave->path,
+				autosave->tmpPath);
+	} else {
+		autosave->child = pid;
+	}
+}
+
+/*
+ * Saves the game right away, once any snapshot being written in the
+ * background is finished with. A game that is between levels, or over, has
+ * nothing to carry on with, so the last snapshot is left as it is. Returns 0
+ * on success, or -1 with errno set if it couldn't be saved.
+ */
+static int
+saveNow(struct autosave *autosave)
+{
+	waitForChild(autosave, 1);
+	if (autosave->game->lives == 0 || autosave->game->blockCount == 0) {
+		return 0;
+	}
+	autosave->last = monotonicTime();
+	return saveSnapshot(autosave->game, autosave->path,
+			autosave->tmpPath);
+}
+
+/*
+ * Called from a handler for a signal that should save the game and quit.
+ * Saves the game right away if it is between frames. Returns 1 if it was
+ * saved, or 0 if it is in the middle of a frame, in which case it is saved at
+ * the end of the frame, and then quit.
+ */
+int
+saveOnSignal(struct autosave *autosave)
+{
+	const int saved = errno;
+
+	if (!autosave->settled) {
+		autosave->stopping = 1;
+		return 0;
+	}
+	saveNow(autosave);
+	autosave->stopping = 2;
+	errno = saved;
+	return 1;
+}
+
+/*
+ * Writes a snapshot of game to tmpPath, then renames it over path. The
+ * snapshot is written with a single call to writev(2), and nothing here
+ * allocates memory, so it is safe to call from a signal handler or a child
+ * process. Returns 0 on success, or -1 with errno set.
+ */
+int
+saveSnapshot(const struct game *game, const char *path, const char *tmpPath)
+{
+	struct snapshotHeader header;
+	struct iovec parts[2];
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.width = game->width;
+	header.height = game->height;
+	header.balls = game->startBalls;
+	header.multiball = game->multiball;
+	header.level = game->level;
+	header.lives = game->lives;
+	header.score = game->score;
+	header.lifeFrames = game->lifeFrames;
+	header.ballCount = game->balls.count;
+	header.blockCount = game->blockCount;
+	header.frames = game->frames;
+	header.blocksDestroyed = game->blocksDestroyed;
+	header.seed = game->seed;
+	memcpy(header.rng, game->rng.s, sizeof(header.rng));
+	header.arenaSize = game->arena.used;
+
+	parts[0].iov_base = &header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = game->arena.base;
+	parts[1].iov_len = game->arena.used;
+	const ssize_t size = sizeof(header) + game->arena.used;
+
+	int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	const ssize_t written = writev(fd, parts, 2);
+	if (written >= 0 && written < size) {
+		/* Only running out of room cuts a write to a file short. */
+		errno = ENOSPC;
+	}
+	/* The snapshot has to be on the disk before it replaces the last one,
+	 * or a crash could leave neither. */
+	if (written != size || fsync(fd) != 0) {
+		const int saved = errno;
+		close(fd);
+		unlink(tmpPath);
+		errno = saved;
+		return -1;
+	}
+	if (close(fd) != 0 || rename(tmpPath, path) != 0) {
+		const int saved = errno;
+		unlink(tmpPath);
+		errno = saved;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Called whenever the game is between frames. A game that a signal asked to
+ * be saved while it was in the middle of one is saved now.
+ */
+static void
+settle(struct autosave *autosave)
+{
+	autosave->settled = 1;
+	if (autosave->stopping == 1) {
+		saveNow(autosave);
+		autosave->stopping = 2;
+	}
+}
+
+/*
+ * Starts saving game to path, as it takes input from source. Returns 0 on
+ * success, or -1 with errno set if there isn't enough memory.
+ */
+int
+startAutosave(struct autosave *autosave, struct input *source,
+		const struct game *game, const char *path)
+{
+	autosave->source = source;
+	autosave->game = game;
+	autosave->path = malloc(strlen(path) + 1);
+	autosave->tmpPath = malloc(strlen(path) + sizeof(".tmp"));
+	if (autosave->path == NULL || autosave->tmpPath == NULL) {
+		free(autosave->path);
+		free(autosave->tmpPath);
+		errno = ENOMEM;
+		return -1;
+	}
+	strcpy(autosave->path, path);
+	strcpy(autosave->tmpPath, path);
+	strcat(autosave->tmpPath, ".tmp");
+	autosave->last = monotonicTime();
+	autosave->child = 0;
+	autosave->error = 0;
+	autosave->settled = 0;
+	autosave->stopping = 0;
+
+	autosave->input.due = autosaveDue;
+	autosave->input.wait = autosaveWait;
+	autosave->input.read = autosaveRead;
+	autosave->input.resume = autosaveResume;
+	autosave->input.anykey = autosaveAnykey;
+	return 0;
+}
+
+/*
+ * Stops saving the game, once the last snapshot is written. A game that is
+ * over is removed, since there is nothing left to resume. Returns 0 on
+ * success, or -1 with errno set if the game couldn't be saved when it was
+ * quit, or couldn't be removed.
+ */
+int
+stopAutosave(struct autosave *autosave)
+{
+	int error = autosave->error;
+
+	waitForChild(autosave, 1);
+	if (autosave->game->lives == 0 && unlink(autosave->path) != 0
+			&& errno != ENOENT) {
+		error = errno;
+	}
+	free(autosave->path);
+	free(autosave->tmpPath);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Reaps the process writing a snapshot in the background, if there is one,
+ * waiting for it to finish if block is set. Returns 1 if there is none left,
+ * or 0 if it is still going.
+ */
+static int
+waitForChild(struct autosave *autosave, int block)
+{
+	pid_t pid;
+
+	if (autosave->child == 0) {
+		return 1;
+	}
+	do {
+		pid = waitpid(autosave->child, NULL, block ? 0 : WNOHANG);
+	} while (pid < 0 && errno == EINTR);
+	if (pid != 0) {
+		autosave->child = 0;
+	}
+	return autosave->child == 0;
+}
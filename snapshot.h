@@ -0,0 +1,135 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Saving a game part way through, to carry on with later. A snapshot is
+ * everything the game needs to go on exactly as it would have: a header with
+ * the rules, the counters and the state of the random number generator,
+ * followed by the whole of the game's arena, which holds the board, the
+ * blocks, the balls and the paddle.
+ *
+ * The header is a struct snapshotHeader as it is laid out in memory, and the
+ * arena is written as it is, so that a snapshot is saved with a single write
+ * and loaded without any parsing. That means a snapshot can only be resumed by
+ * a build of the game that lays things out the same way; one from anywhere
+ * else is turned down, since its version or arena size won't match.
+ *
+ * A snapshot is taken between frames, so it is always of the middle of a
+ * life. It doesn't hold the level pack the boards come from, if there is one,
+ * so a game saved from a pack has to be resumed with the same pack for the
+ * levels after the one saved to be the same.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "game.h"
+
+/*
+ * The start of a snapshot. Everything is a fixed size, in an order that
+ * leaves no padding between the fields.
+ */
+struct snapshotHeader {
+	/* "ABSV", and the version of the layout. */
+	char magic[4];
+	uint32_t version;
+
+	/* The rules of the game: see struct rules. */
+	int32_t width;
+	int32_t height;
+	int32_t balls;
+	int32_t multiball;
+
+	int32_t level;
+	int32_t lives;
+	uint32_t score;
+	uint32_t lifeFrames;
+	int32_t ballCount;
+	int32_t blockCount;
+	uint64_t frames;
+	uint64_t blocksDestroyed;
+	uint64_t seed;
+	uint64_t rng[4];
+
+	/* How many bytes of arena follow the header. */
+	uint64_t arenaSize;
+};
+
+/*
+ * A snapshot read into memory.
+ */
+struct snapshot {
+	struct snapshotHeader header;
+	unsigned char *arena;
+};
+
+/*
+ * An input that passes everything through from source, saving game to path
+ * every so often, and when the player quits. A snapshot being saved while the
+ * game is going on is written by a child process, from its own copy of the
+ * game, so that the game doesn't have to wait for the disk.
+ */
+struct autosave {
+	struct input input;
+	struct input *source;
+	const struct game *game;
+	char *path;
+
+	/* Snapshots are written here first, then renamed over path, so that
+	 * path always holds a whole one. */
+	char *tmpPath;
+
+	/* When the last snapshot was taken, and the process writing it, or 0
+	 * if there isn't one. */
+	long long last;
+	pid_t child;
+
+	/* The error from saving the game when the player quit, or 0 if it
+	 * was saved. */
+	int error;
+
+	/* Whether the game is between frames, waiting on source, so that a
+	 * snapshot of it can be taken right away; and whether the game is
+	 * to be saved and quit, after a signal. stopping is 1 until the game
+	 * has been saved, then 2. */
+	volatile sig_atomic_t settled;
+	volatile sig_atomic_t stopping;
+};
+
+/*
+ * How often a game is saved while it is being played, in nanoseconds.
+ */
+extern const long long AUTOSAVE_INTERVAL;
+
+void freeSnapshot(struct snapshot *snapshot);
+int loadSnapshot(struct snapshot *snapshot, const char *path);
+int resumeGame(struct game *game, const struct snapshot *snapshot,
+		const struct levelPack *levels, struct renderer *renderer,
+		struct input *input);
+int saveOnSignal(struct autosave *autosave);
+int saveSnapshot(const struct game *game, const char *path,
+		const char *tmpPath);
+int startAutosave(struct autosave *autosave, struct input *source,
+		const struct game *game, const char *path);
+int stopAutosave(struct autosave *autosave);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,1547 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "broadcast.h"
+#include "instrument.h"
+#if INSTRUMENT
+#define RUTIL_SYSCALL(written) instrumentSyscall(written)
+#endif
+/* Everything written to the terminal goes to the viewers too. */
+static void copyOutput(const char *buf, size_t len);
+#define RUTIL_OUTPUT(buf, len) copyOutput(buf, len)
+#include "rogueutil.h"
+#include "term.h"
+
+/*
+ * Strings for the footer at the bottom of the game board.
+ */
+const char *TITLE = "ASCII BREAKOUT";
+const char *LIVES_FOOTER = "<3:";
+const char *LEVEL_FOOTER = "Level:";
+const char *SCORE_FOOTER = "Score:";
+const int INBETWEEN = 5;
+const int FOOTER_XPOS = 4;
+
+/*
+ * Length of a frame, in nanoseconds. Controls the speed of the game; speed of
+ * the ball and the paddle, mainly. Changing this value will also require
+ * changing the various velocities of the ball and paddle for gameplay to
+ * remain smooth.
+ */
+const long long FRAME_LENGTH = 5000000;
+
+/*
+ * How many bytes a second are sent to the terminal in low-bandwidth mode:
+ * about what a 38400 baud line carries.
+ */
+const long LOW_BANDWIDTH = 3840;
+
+/*
+ * The longest the screen goes without being sent to the terminal when the
+ * terminal can't keep up, in nanoseconds.
+ */
+static const long long MAX_RENDER_INTERVAL = 200000000;
+
+/*
+ * Dimensions of the play field, and of the screen, which is the play field
+ * plus the border around it. The footer is drawn over the bottom of the
+ * border.
+ */
+static int boardWidth;
+static int boardHeight;
+static int screenWidth;
+static int screenHeight;
+
+/*
+ * A character space on the screen, and the colors it is drawn in. A color of
+ * -1 means the terminal's default color.
+ */
+struct cell {
+	char ch;
+	signed char fg;
+	signed char bg;
+};
+
+/*
+ * The screen is double-buffered. Everything is drawn into back, and present()
+ * sends to the terminal only the cells of back that differ from front, which
+ * holds what is currently on the terminal. Both are screenWidth cells across
+ * and screenHeight down, stored a row at a time starting from the top-left
+ * corner of the terminal.
+ */
+static struct cell *back;
+static struct cell *front;
+
+/*
+ * What a cell looks like on a freshly cleared terminal.
+ */
+static const struct cell BLANK_CELL = {' ', -1, -1};
+
+/*
+ * Whether the terminal has been cleared since terminalBegin(). Until it has,
+ * front doesn't hold what is on the terminal, so the first redraw clears it.
+ * After that, redrawing the screen sends only the cells that have changed.
+ */
+static int screenCleared;
+
+/*
+ * What each kind of tile looks like, on an even x [on the terminal window] and
+ * on an odd one. A block is drawn as "()", which helps show the player that
+ * blocks are two characters wide. The board is drawn two cells in from the
+ * left of the screen, and the first tile of a block is always on an odd x on
+ * the board (as destroyBlock() relies on), so it is on an odd x on the screen
+ * too. Every other kind of tile looks the same either way.
+ */
+static const struct cell TILE_CELLS[][2] = {
+	[EMPTY] = { {' ', -1, -1}, {' ', -1, -1} },
+	[BALL] = { {'O', -1, -1}, {'O', -1, -1} },
+	[PADDLE] = { {' ', -1, MAGENTA}, {' ', -1, MAGENTA} },
+	[RED_BLOCK] = { {')', BLACK, RED}, {'(', BLACK, RED} },
+	[BLUE_BLOCK] = { {')', BLACK, BLUE}, {'(', BLACK, BLUE} },
+	[GREEN_BLOCK] = { {')', BLACK, GREEN}, {'(', BLACK, GREEN} },
+};
+
+/*
+ * Where the screen is on the terminal: its top-left corner is offsetX cells
+ * right of the terminal's, and offsetY cells down, so that it is in the middle
+ * of the terminal. If the terminal is too small for all of it, only the top
+ * visibleWidth cells across and visibleHeight down are sent, leaving one
+ * column and row free for the cursor. They are worked out again whenever the
+ * terminal is cleared.
+ */
+static int offsetX;
+static int offsetY;
+static int visibleWidth;
+static int visibleHeight;
+
+/*
+ * Set when the terminal has been resized, and the screen has to be laid out
+ * on it again.
+ */
+static volatile sig_atomic_t resized;
+
+/*
+ * Set when there is no more input to be read, because stdin has reached its
+ * end or can't be read. The game is quit, and nothing more is waited for.
+ */
+static int inputEnded;
+
+/*
+ * Where the terminal's cursor is, counting from 1 like locate() does, but
+ * from the top-left corner of the screen rather than of the terminal, or 0 if
+ * that isn't known.
+ */
+static int cursorX;
+static int cursorY;
+
+/*
+ * The screen is normally sent to the terminal after every frame. When the
+ * terminal can't keep up, it is sent at most once every renderInterval
+ * nanoseconds instead, so that the changes from several frames go out as one,
+ * and the game isn't held up waiting on the terminal. nextPresent is the
+ * earliest time it can be sent again, and presentPending is whether there is
+ * anything drawn since the last time that is waiting to be sent (or, with a
+ * render thread, to be queued). presentPending belongs to the game's thread.
+ */
+static long long renderInterval;
+static long long nextPresent;
+static int presentPending;
+
+/*
+ * The most bytes a second that can be sent to the terminal, or 0 if there is
+ * no limit. As of the time tokensTime, tokens bytes can be sent right away; it
+ * is negative if the limit has already been gone over.
+ */
+static long bandwidth;
+static double tokens;
+static long long tokensTime;
+
+/*
+ * How many screens can be waiting for the render thread at once.
+ */
+#define QUEUE_SIZE 3
+
+/*
+ * With a render thread, present() copies the screen into the next slot of
+ * queue, and the render thread sends it to the terminal, so that the game
+ * never waits on the terminal. queue holds QUEUE_SIZE screens, one after the
+ * other. queueHead counts the screens ever put in (by the game) and queueTail
+ * the ones ever taken out (by the render thread), so screen n goes in slot
+ * n % QUEUE_SIZE, and the queue is full when they are QUEUE_SIZE apart. Only
+ * the game writes queueHead, and only the render thread writes queueTail, so
+ * neither needs a lock. queueClear[slot] is whether the terminal has to be
+ * cleared before that screen is drawn.
+ *
+ * From the time the render thread starts until terminalEnd() stops it, it is
+ * the only one that touches the terminal's output (and front, and the cursor
+ * and the bandwidth limit). The game wakes it up by writing a byte to
+ * wakeFds[1].
+ */
+static int threaded;
+static pthread_t renderThread;
+static struct cell *queue;
+static int queueClear[QUEUE_SIZE];
+static unsigned long queueHead;
+static unsigned long queueTail;
+static unsigned long renderStop;
+static int wakeFds[2];
+
+#ifndef __GNUC__
+/*
+ * Without the GNU builtins for atomic loads and stores, loadShared() and
+ * storeShared() use this lock instead.
+ */
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * Whether the terminal has to be cleared before the next screen the game puts
+ * in the queue is drawn.
+ */
+static int clearPending;
+
+/*
+ * The broadcast of the screen to viewers over the network, if broadcasting is
+ * set. It belongs to whichever thread sends the output.
+ */
+static int broadcasting;
+static struct broadcast broadcast;
+
+/*
+ * The most bytes a cell takes in a keyframe: a reset and both colors, then
+ * the character itself. Each row takes up to as many again to move to.
+ */
+#define KEYFRAME_CELL 32
+
+/*
+ * A number in the footer: where its digits start, the fewest digits it is
+ * shown with, and the digits it was last drawn with (least significant
+ * first), so that only the ones that change have to be drawn again. shownLen
+ * is 0 if it hasn't been drawn since the screen was last started over.
+ */
+struct counter {
+	int x;
+	int width;
+	char shown[24];
+	int shownLen;
+};
+
+/*
+ * The counters in the footer, laid out by terminalBegin().
+ */
+static struct counter livesCounter;
+static struct counter levelCounter;
+static struct counter scoreCounter;
+
+#if INSTRUMENT
+/*
+ * Whether the measurements are being shown over the top of the border, and
+ * when what is shown was last brought up to date.
+ */
+static int hudShown;
+static long long hudTime;
+
+/*
+ * How often the measurements shown are brought up to date, in nanoseconds.
+ */
+static const long long HUD_INTERVAL = 250000000;
+#endif
+
+/*
+ * The clock that frames are timed by: frame number clockFrame was due at the
+ * time clockStart.
+ */
+static long long clockStart;
+static unsigned long clockFrame;
+
+static void bar(int x, int y, int len, char c, int color);
+static void clearScreen(void);
+static void clearTerminal(void);
+static int cursorSequence(char *buf, int n, char final);
+static void drawCell(int x, int y, char ch, int fg, int bg);
+static void drawCounter(struct counter *counter, unsigned long value);
+#if INSTRUMENT
+static void drawHud(void);
+#endif
+static void drawMessage(struct renderer *r, const char *text);
+static void drawString(int x, int y, const char *s, int fg, int bg);
+static void drawTile(int x, int y, enum tile t);
+static void initializeGraphics(struct renderer *r, const struct game *game);
+static void layOut(void);
+static unsigned long loadShared(const unsigned long *p);
+static void moveCursor(const struct cell *screen, int x, int y);
+static void noteResize(int sig);
+static void present(struct renderer *r);
+static int queueScreen(void);
+static void readControls(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused);
+static void relayOut(void);
+static void *render(void *arg);
+static void sendScreen(const struct cell *screen);
+static void storeShared(unsigned long *p, unsigned long value);
+static void termAnykey(struct input *in);
+static unsigned long termDue(struct input *in);
+static void termResume(struct input *in, unsigned long frame);
+static void termTile(struct renderer *r, int x, int y, enum tile t);
+static void termWait(struct input *in, unsigned long frame);
+static void updateLevel(struct renderer *r, int level);
+static void updateLives(struct renderer *r, int lives);
+static void updateScore(struct renderer *r, unsigned int score);
+static int waitForInput(int timeout);
+static size_t writeKeyframe(char *buf, size_t size);
+
+struct renderer terminalRenderer = {
+	termTile,
+	updateLives,
+	updateLevel,
+	updateScore,
+	initializeGraphics,
+	drawMessage,
+	present,
+};
+
+struct input terminalInput = {
+	termDue,
+	termWait,
+	readControls,
+	termResume,
+	termAnykey,
+};
+
+/*
+ * Draws a horizontal bar across the screen.
+ */
+static void
+bar(int x, int y, int len, char c, int color)
+{
+	for (int i = 0; i < len; i++) {
+		drawCell(x + i, y, c, color, -1);
+	}
+}
+
+/*
+ * Clears the terminal. The cells in back are left alone, so they will all be
+ * drawn again by the next present(). With a render thread, the render thread
+ * does the clearing, before it draws the next screen.
+ */
+static void
+clearScreen(void)
+{
+	screenCleared = 1;
+	if (threaded) {
+		clearPending = 1;
+	} else {
+		clearTerminal();
+	}
+}
+
+/*
+ * Does the work of clearScreen(), on whichever thread sends the output.
+ */
+static void
+clearTerminal(void)
+{
+	/* The terminal might not be the size it was the last time. */
+	layOut();
+	/* Colors are reset first so that the terminal is cleared to the
+	 * default background. */
+	resetColor();
+	cls();
+	/* That leaves the cursor in the top-left corner of the terminal,
+	 * which is only somewhere on the screen if the screen is there too.
+	 */
+	cursorX = offsetX == 0 && offsetY == 0 ? 1 : 0;
+	cursorY = cursorX;
+	for (int i = 0; i < screenWidth * screenHeight; i++) {
+		front[i] = BLANK_CELL;
+	}
+}
+
+/*
+ * Copies len bytes of output from buf to the broadcast, if there is one.
+ */
+static void
+copyOutput(const char *buf, size_t len)
+{
+	if (broadcasting) {
+		broadcastOutput(&broadcast, buf, len);
+	}
+}
+
+/*
+ * Writes into buf the control sequence that moves the cursor n cells in the
+ * direction given by final ('A' up, 'B' down, 'C' right or 'D' left), and
+ * returns its length. n is left out when it is 1, since that is the default.
+ */
+static int
+cursorSequence(char *buf, int n, char final)
+{
+	char digits[12];
+	int len = 0, count = 0;
+
+	buf[len++] = '\033';
+	buf[len++] = '[';
+	if (n != 1) {
+		do {
+			digits[count++] = (char)('0' + n % 10);
+			n /= 10;
+		} while (n > 0);
+		while (count > 0) {
+			buf[len++] = digits[--count];
+		}
+	}
+	buf[len++] = final;
+	return len;
+}
+
+/*
+ * Draws a character at (x, y) [on the terminal window] in the given colors.
+ * Cells outside of the screen are ignored.
+ */
+static void
+drawCell(int x, int y, char ch, int fg, int bg)
+{
+	struct cell *c;
+
+	if (x < 1 || x > screenWidth || y < 1 || y > screenHeight) {
+		return;
+	}
+	c = &back[(y - 1) * screenWidth + (x - 1)];
+	c->ch = ch;
+	c->fg = fg;
+	c->bg = bg;
+}
+
+/*
+ * Draws value into counter, redrawing only the digits that changed since it
+ * was last drawn.
+ */
+static void
+drawCounter(struct counter *counter, unsigned long value)
+{
+	char digits[sizeof(counter->shown)];
+	int len = 0;
+
+	do {
+		digits[len++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0 || len < counter->width);
+
+	/* If the number got longer or shorter, all of it moves over. */
+	if (len != counter->shownLen) {
+		for (int i = len; i < counter->shownLen; i++) {
+			drawCell(counter->x + i, screenHeight, '_', GREEN, -1);
+		}
+		counter->shownLen = 0;
+	}
+	for (int i = 0; i < len; i++) {
+		if (counter->shownLen == 0 || digits[i] != counter->shown[i]) {
+			drawCell(counter->x + len - 1 - i, screenHeight,
+					digits[i], -1, -1);
+			counter->shown[i] = digits[i];
+		}
+	}
+	counter->shownLen = len;
+}
+
+#if INSTRUMENT
+/*
+ * Shows the measurements so far over the top of the border, or the border
+ * again if they have been hidden. They are brought up to date a few times a
+ * second, so as not to add much to what is being measured.
+ */
+static void
+drawHud(void)
+{
+	char text[256];
+	const long long now = monotonicTime();
+
+	if (!hudShown) {
+		if (hudTime != 0) {
+			bar(2, 1, boardWidth, '_', GREEN);
+			hudTime = 0;
+		}
+		return;
+	}
+	/* A redraw wipes it out, so that has to be checked for too. */
+	if (now - hudTime < HUD_INTERVAL && back[1].ch != '_') {
+		return;
+	}
+	instrumentSummary(text, sizeof(text));
+	bar(2, 1, boardWidth, '_', GREEN);
+	for (int i = 0; text[i] != '\0' && i < boardWidth; i++) {
+		drawCell(2 + i, 1, text[i], YELLOW, -1);
+	}
+	hudTime = now;
+}
+#endif
+
+/*
+ * Draws a message, centered on the playfield.
+ */
+static void
+drawMessage(struct renderer *r, const char *text)
+{
+	int line_number = 0;
+
+	(void)r;
+
+	while (*text != '\0') {
+		int len = (int)strcspn(text, "\n");
+		int x = boardWidth / 2 - len / 2;
+		for (int i = 0; i < len; i++) {
+			drawCell(x + i, boardHeight / 2 + line_number, text[i],
+					-1, -1);
+		}
+		text += len;
+		/* Blank lines are skipped. */
+		if (len > 0) {
+			line_number++;
+		}
+		text += strspn(text, "\n");
+	}
+}
+
+/*
+ * Draws a string starting at (x, y) [on the terminal window] in the given
+ * colors.
+ */
+static void
+drawString(int x, int y, const char *s, int fg, int bg)
+{
+	for (int i = 0; s[i] != '\0'; i++) {
+		drawCell(x + i, y, s[i], fg, bg);
+	}
+}
+
+/*
+ * Draws tile t at (x, y) [on the terminal window], as TILE_CELLS has it. What
+ * is drawn depends only on the tile and where it is, so tiles can be drawn in
+ * any order.
+ */
+static void
+drawTile(int x, int y, enum tile t)
+{
+	if (x < 1 || x > screenWidth || y < 1 || y > screenHeight) {
+		return;
+	}
+	back[(y - 1) * screenWidth + (x - 1)] = TILE_CELLS[t][x % 2];
+}
+
+/*
+ * Draws initial graphics for the game. This includes a box around the playing
+ * field, the score, the paddle, the blocks, etc. Everything is drawn again into
+ * back, but the terminal is only cleared the first time: after that, present()
+ * sends just the cells that differ from what is on the terminal already, such
+ * as those under a message or where the balls and paddle were.
+ */
+static void
+initializeGraphics(struct renderer *r, const struct game *game)
+{
+	/* Start over from a blank screen. */
+	for (int i = 0; i < screenWidth * screenHeight; i++) {
+		back[i] = BLANK_CELL;
+	}
+	/* Draws a box around the game field. */
+	bar(2, 1, boardWidth, '_', GREEN); /* Top bar */
+	for (int y = 2; y < screenHeight; y++) { /* Sides of the game field */
+		drawCell(1, y, '{', GREEN, -1);
+		drawCell(screenWidth, y, '}', GREEN, -1);
+	}
+	drawCell(1, screenHeight, '{', GREEN, -1);
+	bar(2, screenHeight, boardWidth, '_', GREEN); /* Bottom bar */
+	drawCell(screenWidth, screenHeight, '}', GREEN, -1);
+	/* Prints footer information. */
+	/* title */
+	drawString(FOOTER_XPOS, screenHeight, TITLE, CYAN, -1);
+	/* lives */
+	drawString(livesCounter.x - strlen(LIVES_FOOTER), screenHeight,
+			LIVES_FOOTER, LIGHTMAGENTA, -1);
+	livesCounter.shownLen = 0;
+	updateLives(r, game->lives);
+	/* level */
+	drawString(levelCounter.x - strlen(LEVEL_FOOTER), screenHeight,
+			LEVEL_FOOTER, YELLOW, -1);
+	levelCounter.shownLen = 0;
+	updateLevel(r, game->level);
+	/* score */
+	drawString(scoreCounter.x - strlen(SCORE_FOOTER), screenHeight,
+			SCORE_FOOTER, LIGHTCYAN, -1);
+	scoreCounter.shownLen = 0;
+	updateScore(r, game->score);
+	/* Draws the board tiles. i and j refer to y and x, so that the tiles
+	 * are drawn in the order they are laid out in board. */
+	for (int i = 0; i < game->height; i++) {
+		for (int j = 0; j < game->width; j++) {
+			drawTile(j + 2, i + 2, TILE(game, j, i));
+		}
+	}
+	/* The balls go over the board. */
+	for (int i = 0; i < game->balls.count; i++) {
+		drawTile(game->balls.x[i] + 2, game->balls.y[i] + 2, BALL);
+	}
+	if (!screenCleared) {
+		clearScreen();
+	}
+	present(r);
+}
+
+/*
+ * Works out where the screen goes on the terminal, from the size the terminal
+ * is now. If the size isn't known, the screen goes in the top-left corner.
+ */
+static void
+layOut(void)
+{
+	const int columns = tcols();
+	const int rows = trows();
+	const int oldX = offsetX, oldY = offsetY;
+
+	offsetX = columns > screenWidth + 1
+		? (columns - screenWidth - 1) / 2 : 0;
+	offsetY = rows > screenHeight + 1 ? (rows - screenHeight - 1) / 2 : 0;
+	visibleWidth = columns > 1 ? min(screenWidth, columns - 1)
+		: screenWidth;
+	visibleHeight = rows > 1 ? min(screenHeight, rows - 1) : screenHeight;
+
+	/* The moves worked out up front for locate() have to reach as far as
+	 * the screen does now. */
+	if (offsetX != oldX || offsetY != oldY) {
+		locateCache(screenWidth + 1 + offsetX,
+				screenHeight + 1 + offsetY);
+	}
+}
+
+/*
+ * Reads *p, which another thread is writing, along with everything that thread
+ * wrote before it.
+ */
+static unsigned long
+loadShared(const unsigned long *p)
+{
+#ifdef __GNUC__
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+	unsigned long value;
+
+	pthread_mutex_lock(&sharedLock);
+	value = *p;
+	pthread_mutex_unlock(&sharedLock);
+	return value;
+#endif
+}
+
+/*
+ * Returns the time in nanoseconds on a clock that only ever goes forward.
+ */
+long long
+monotonicTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Moves the cursor to (x, y) [on the terminal window] in as few bytes as it
+ * can. That can be an absolute move, a relative move up or down and then
+ * across (from where the cursor is, or from the start of the line after a
+ * carriage return), or, going right along a line, just writing out the cells
+ * of screen in between again.
+ */
+static void
+moveCursor(const struct cell *screen, int x, int y)
+{
+	/* Room for a move up or down, a carriage return, and a move across.
+	 */
+	char best[32];
+	/* An absolute move is "\033[" y ";" x "f", and always works. Until
+	 * something beats it, bestLen is its length, and best is unused. */
+	int bestLen = 4, absolute = 1;
+
+	if (x == cursorX && y == cursorY) {
+		return;
+	}
+	for (int n = x + offsetX; n > 0; n /= 10) {
+		bestLen++;
+	}
+	for (int n = y + offsetY; n > 0; n /= 10) {
+		bestLen++;
+	}
+
+	if (cursorX != 0) {
+		char option[32];
+		int len = 0;
+
+		if (y != cursorY) {
+			len = cursorSequence(option, abs(y - cursorY),
+					y > cursorY ? 'B' : 'A');
+		}
+		/* Then across, from where the cursor is or from the start of
+		 * the line, whichever is shorter. */
+		char across[16], fromStart[16];
+		int acrossLen = 0, fromStartLen = 1;
+		if (x != cursorX) {
+			acrossLen = cursorSequence(across, abs(x - cursorX),
+					x > cursorX ? 'C' : 'D');
+		}
+		fromStart[0] = '\r';
+		if (x + offsetX > 1) {
+			fromStartLen += cursorSequence(fromStart + 1,
+					x + offsetX - 1, 'C');
+		}
+		if (fromStartLen < acrossLen) {
+			memcpy(option + len, fromStart, fromStartLen);
+			len += fromStartLen;
+		} else {
+			memcpy(option + len, across, acrossLen);
+			len += acrossLen;
+		}
+		if (len < bestLen) {
+			memcpy(best, option, len);
+			bestLen = len;
+			absolute = 0;
+		}
+
+		/* The cells in between can be written again as they are if
+		 * they are up to date, and in the colors the terminal is
+		 * already using. */
+		if (y == cursorY && x > cursorX && x - cursorX < bestLen
+				&& y <= screenHeight) {
+			const struct cell *b = &screen[(y - 1) * screenWidth];
+			const struct cell *f = &front[(y - 1) * screenWidth];
+			int same = 1;
+			for (int i = cursorX - 1; i < x - 1 && same; i++) {
+				same = b[i].ch == f[i].ch && b[i].fg == f[i].fg
+					&& b[i].bg == f[i].bg
+					&& b[i].fg == rutil_fg
+					&& b[i].bg == rutil_bg;
+			}
+			if (same) {
+				for (int i = cursorX - 1; i < x - 1; i++) {
+					best[i - (cursorX - 1)] = b[i].ch;
+				}
+				bestLen = x - cursorX;
+				absolute = 0;
+			}
+		}
+	}
+
+	if (absolute) {
+		locate(x + offsetX, y + offsetY);
+	} else {
+		rutil_write(best, bestLen);
+	}
+	cursorX = x;
+	cursorY = y;
+}
+
+/*
+ * Called when the terminal is resized. The screen is laid out again between
+ * frames, since it can't be done from here.
+ */
+static void
+noteResize(int sig)
+{
+	(void)sig;
+	resized = 1;
+}
+
+/*
+ * Sends the cells that have changed since the screen was last sent to the
+ * terminal, unless the terminal is too backed up to take them yet; then they
+ * are held back, to go out with whatever gets drawn next.
+ */
+static void
+present(struct renderer *r)
+{
+	(void)r;
+
+#if INSTRUMENT
+	drawHud();
+#endif
+	if (threaded) {
+		/* If the render thread is that far behind, the screen waits
+		 * for the next time around. */
+		presentPending = !queueScreen();
+		return;
+	}
+	if (monotonicTime() < nextPresent) {
+		presentPending = 1;
+		return;
+	}
+	presentPending = 0;
+	sendScreen(back);
+}
+
+/*
+ * Puts a copy of the screen in the queue for the render thread and wakes it
+ * up. Returns 1 on success, or 0 if the queue is full.
+ */
+static int
+queueScreen(void)
+{
+	const unsigned long head = queueHead;
+	const size_t cells = (size_t)screenWidth * screenHeight;
+
+	if (head - loadShared(&queueTail) == QUEUE_SIZE) {
+		return 0;
+	}
+	memcpy(&queue[head % QUEUE_SIZE * cells], back,
+			cells * sizeof(*back));
+	queueClear[head % QUEUE_SIZE] = clearPending;
+	clearPending = 0;
+	storeShared(&queueHead, head + 1);
+	/* If the pipe is full, the render thread has a wakeup coming
+	 * anyway. */
+	if (write(wakeFds[1], "", 1) < 0) {
+		;
+	}
+	INSTRUMENT_SYSCALL(0);
+	return 1;
+}
+
+/*
+ * Reads all of the input waiting since the last frame into controls. isPaused
+ * is whether the game is paused going into this frame; movement keys pressed
+ * while the game is paused are ignored.
+ */
+static void
+readControls(struct input *in, struct controls *controls,
+		unsigned long frame, int isPaused)
+{
+	char keys[64];
+	int n;
+
+	(void)in;
+	(void)frame;
+
+	controls->direction = 0;
+	controls->togglePause = 0;
+	controls->quit = 0;
+	controls->redraw = 0;
+
+	if (resized) {
+		relayOut();
+	}
+	if (inputEnded) {
+		controls->quit = 1;
+		return;
+	}
+
+	do {
+		n = nb_read(keys, sizeof(keys));
+		if (n < 0) {
+			inputEnded = 1;
+			controls->quit = 1;
+			return;
+		}
+		for (int i = 0; i < n; i++) {
+			switch (keys[i]) {
+			case 'p':
+			case 'P':
+				isPaused = !isPaused;
+				controls->togglePause = !controls->togglePause;
+				break;
+			case 'j': /* move the paddle left */
+			case 'J':
+				if (!isPaused) {
+					controls->direction = -1;
+				}
+				break;
+			case 'k': /* move the paddle right */
+			case 'K':
+				if (!isPaused) {
+					controls->direction = 1;
+				}
+				break;
+			case 'q': /* quits the game. */
+			case 'Q':
+				controls->quit = 1;
+				return;
+			case 'r': /* redraw the screen. doesn't control the paddle. */
+			case 'R':
+				/* The point is to fix up a terminal that has
+				 * been messed up, so everything is sent
+				 * again. */
+				clearScreen();
+				controls->redraw = 1;
+				break;
+#if INSTRUMENT
+			case 'i': /* show or hide the measurements. */
+			case 'I':
+				hudShown = !hudShown;
+				break;
+#endif
+			}
+		}
+	} while (n == sizeof(keys));
+}
+
+/*
+ * Lays the screen out again on a terminal that has been resized. Nothing is
+ * drawn again: the terminal is cleared, so all of what is already in back goes
+ * out with the next present(), in one write, wherever it belongs now.
+ */
+static void
+relayOut(void)
+{
+	resized = 0;
+	clearScreen();
+	presentPending = 1;
+}
+
+/*
+ * The render thread: sends the screens the game puts in the queue to the
+ * terminal. If it falls behind, it skips to the newest one, so that more than
+ * one frame's worth of changes goes out at once.
+ */
+static void *
+render(void *arg)
+{
+	const size_t cells = (size_t)screenWidth * screenHeight;
+	char drain[64];
+
+	(void)arg;
+
+	for (;;) {
+		struct pollfd p[1 + BROADCAST_FDS] = {
+			{ wakeFds[0], POLLIN, 0 }
+		};
+		int count = 1;
+		/* Viewers are seen to while there is nothing new to send. */
+		if (broadcasting) {
+			count += broadcastFds(&broadcast, p + 1);
+		}
+		poll(p, count, -1);
+		INSTRUMENT_SYSCALL(0);
+		if (broadcasting && !(p[0].revents & POLLIN)) {
+			broadcastFrame(&broadcast);
+			continue;
+		}
+		while (read(wakeFds[0], drain, sizeof(drain)) > 0) {
+			INSTRUMENT_SYSCALL(0);
+		}
+		INSTRUMENT_SYSCALL(0);
+
+		const unsigned long head = loadShared(&queueHead);
+		if (head != queueTail) {
+			/* The screens being skipped over might have asked for
+			 * the terminal to be cleared. */
+			int clear = 0;
+			for (unsigned long i = queueTail; i != head; i++) {
+				clear |= queueClear[i % QUEUE_SIZE];
+			}
+			if (clear) {
+				clearTerminal();
+			}
+			sendScreen(&queue[(head - 1) % QUEUE_SIZE * cells]);
+			storeShared(&queueTail, head);
+		}
+
+		if (loadShared(&renderStop)) {
+			return NULL;
+		}
+
+		/* When the terminal is backed up, or there is a bandwidth
+		 * limit, hold off before sending anything else. */
+		const long long left = nextPresent - monotonicTime();
+		if (left > 0) {
+			struct timespec ts = {
+				left / 1000000000, left % 1000000000
+			};
+			nanosleep(&ts, NULL);
+			INSTRUMENT_SYSCALL(0);
+		}
+	}
+}
+
+/*
+ * Sends the cells of screen that have changed since the last call to the
+ * terminal, all in one write.
+ */
+static void
+sendScreen(const struct cell *screen)
+{
+	int changed = 0;
+
+	for (int y = 0; y < visibleHeight; y++) {
+		for (int x = 0; x < visibleWidth; x++) {
+			const struct cell *b = &screen[y * screenWidth + x];
+			struct cell *f = &front[y * screenWidth + x];
+			if (b->ch == f->ch && b->fg == f->fg && b->bg == f->bg) {
+				continue;
+			}
+			/* Cells next to each other on a line come out as one
+			 * run of characters, since writing one leaves the
+			 * cursor on the next. */
+			moveCursor(screen, x + 1, y + 1);
+			setColors(b->fg, b->bg);
+			rutil_write(&b->ch, 1);
+			cursorX++;
+			*f = *b;
+			changed = 1;
+		}
+	}
+
+	if (changed) {
+		/* I move the cursor out of the way so that inputs that are
+		 * not caught by nb_getch) are not in the way of the play
+		 * field. */
+		resetColor();
+		moveCursor(screen, visibleWidth + 1, visibleHeight + 1);
+		/* Block the input characters from showing, and go back to
+		 * where they were. */
+		rutil_write("  \033[2D", 6);
+	}
+
+	/* How long the write takes is how backed up the terminal is (or the
+	 * link to it). If it is taking longer than a frame, the screen is sent
+	 * less often, and as it catches up, more often again. */
+	const size_t bytes = rutil_buffered;
+	const long long start = monotonicTime();
+	rutil_flush();
+	const long long now = monotonicTime();
+	INSTRUMENT_TIME(PHASE_FLUSH, now - start);
+	if (now - start > FRAME_LENGTH) {
+		renderInterval = renderInterval < FRAME_LENGTH ? 2 * FRAME_LENGTH
+			: 2 * renderInterval;
+		if (renderInterval > MAX_RENDER_INTERVAL) {
+			renderInterval = MAX_RENDER_INTERVAL;
+		}
+	} else if (now - start < FRAME_LENGTH / 4) {
+		renderInterval = renderInterval * 3 / 4;
+	}
+	nextPresent = now + renderInterval;
+
+	/* The viewers get the frame too. */
+	if (broadcasting) {
+		broadcastFrame(&broadcast);
+	}
+
+	/* With a bandwidth limit, the screen isn't sent again until the
+	 * bytes just sent have been paid for. Up to a tenth of a second's
+	 * worth can be saved up. */
+	if (bandwidth > 0) {
+		tokens += (double)(now - tokensTime) * bandwidth / 1e9;
+		if (tokens > bandwidth / 10.0) {
+			tokens = bandwidth / 10.0;
+		}
+		tokensTime = now;
+		tokens -= bytes;
+		if (tokens < 0) {
+			const long long paid = now
+				+ (long long)(-tokens * 1e9 / bandwidth);
+			if (paid > nextPresent) {
+				nextPresent = paid;
+			}
+		}
+	}
+}
+
+/*
+ * Writes value to *p, which another thread is reading, along with everything
+ * written before it.
+ */
+static void
+storeShared(unsigned long *p, unsigned long value)
+{
+#ifdef __GNUC__
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+#else
+	pthread_mutex_lock(&sharedLock);
+	*p = value;
+	pthread_mutex_unlock(&sharedLock);
+#endif
+}
+
+static void
+termAnykey(struct input *in)
+{
+	char key;
+
+	(void)in;
+
+	/* Whatever is on the screen has to be seen before the player can
+	 * answer it, and seen again if the terminal is resized in the
+	 * meantime. The key is waited for without anykey(), which would
+	 * flush the output, since with a render thread, that is the only
+	 * one that writes to the terminal. If there is no more input, there
+	 * is no key to wait for. */
+	while (!inputEnded) {
+		if (resized) {
+			relayOut();
+		}
+		if (presentPending) {
+			if (threaded) {
+				presentPending = !queueScreen();
+			} else {
+				presentPending = 0;
+				sendScreen(back);
+			}
+		}
+		/* If the queue was full, try again in a frame. Input that
+		 * is waiting but can't be read is the end of it. */
+		if (waitForInput(presentPending
+				? (int)(FRAME_LENGTH / 1000000) : -1)) {
+			if (nb_read(&key, 1) <= 0) {
+				inputEnded = 1;
+			}
+			return;
+		}
+	}
+}
+
+static unsigned long
+termDue(struct input *in)
+{
+	long long now = monotonicTime();
+
+	(void)in;
+
+	if (now < clockStart) {
+		return clockFrame - 1;
+	}
+	return clockFrame + (now - clockStart) / FRAME_LENGTH;
+}
+
+static void
+termResume(struct input *in, unsigned long frame)
+{
+	(void)in;
+	clockStart = monotonicTime() + FRAME_LENGTH;
+	clockFrame = frame;
+}
+
+static void
+termTile(struct renderer *r, int x, int y, enum tile t)
+{
+	(void)r;
+	drawTile(x + 2, y + 2, t);
+}
+
+/*
+ * Sleeps until the frame is due, or until there is input to read. If frame is
+ * 0, sleeps until there is input.
+ */
+static void
+termWait(struct input *in, unsigned long frame)
+{
+	long long deadline, left;
+
+	(void)in;
+
+	/* If the screen was held back, it is sent as soon as it can be, so
+	 * wake up for that too. */
+	if (inputEnded) {
+		return;
+	}
+	if (frame == 0 && !presentPending) {
+		waitForInput(-1);
+		return;
+	}
+	/* With a render thread, the screen was held back because the queue
+	 * was full, so try again in a frame. */
+	const long long retry = threaded ? monotonicTime() + FRAME_LENGTH
+		: nextPresent;
+	deadline = frame == 0 ? retry
+		: clockStart + (long long)(frame - clockFrame) * FRAME_LENGTH;
+	if (presentPending && retry < deadline) {
+		deadline = retry;
+	}
+	left = deadline - monotonicTime();
+	if (left > 0) {
+		/* Round up, so as not to wake up just before the frame is
+		 * due. */
+		waitForInput((int)((left + 999999) / 1000000));
+	}
+}
+
+/*
+ * Gets the terminal ready to play a game with a board of the given size on,
+ * sending it at most bytesPerSecond bytes a second, or as much as it will take
+ * if bytesPerSecond is 0. If useThread is set, the output is sent from a render
+ * thread of its own. If port isn't 0, the screen is broadcast to viewers who
+ * connect to it on address, or on the loopback address if address is NULL
+ * (see startBroadcast()). Returns 0 on success, or -1 with errno set if there
+ * isn't enough memory, the port can't be listened on or the render thread
+ * can't be started.
+ */
+int
+terminalBegin(int width, int height, long bytesPerSecond, int useThread,
+		const char *address, int port)
+{
+	int error;
+
+	boardWidth = width;
+	boardHeight = height;
+	screenWidth = width + 2;
+	screenHeight = height + 2;
+	back = malloc(screenWidth * screenHeight * sizeof(*back));
+	front = malloc(screenWidth * screenHeight * sizeof(*front));
+	if (back == NULL || front == NULL) {
+		free(back);
+		free(front);
+		errno = ENOMEM;
+		return -1;
+	}
+	/* Every position present() moves the cursor to is worked out now, so
+	 * that drawing a frame is just copying. If there isn't room for them,
+	 * locate() works them out as it goes instead. */
+	locateCache(screenWidth + 1, screenHeight + 1);
+	offsetX = 0;
+	offsetY = 0;
+	visibleWidth = screenWidth;
+	visibleHeight = screenHeight;
+
+	/* Nothing has been drawn yet. */
+	screenCleared = 0;
+	for (int i = 0; i < screenWidth * screenHeight; i++) {
+		back[i] = BLANK_CELL;
+		front[i] = BLANK_CELL;
+	}
+	/* The footer is laid out once. Each label starts INBETWEEN cells
+	 * after the start of what comes before it, and its counter right
+	 * after it. */
+	livesCounter.x = FOOTER_XPOS + strlen(TITLE) + INBETWEEN
+		+ strlen(LIVES_FOOTER);
+	livesCounter.width = 2;
+	levelCounter.x = livesCounter.x + INBETWEEN + strlen(LEVEL_FOOTER);
+	levelCounter.width = 2;
+	scoreCounter.x = levelCounter.x + INBETWEEN + strlen(SCORE_FOOTER);
+	scoreCounter.width = 8;
+
+	broadcasting = 0;
+	if (port != 0) {
+		const size_t keyframeSize = ((size_t)screenWidth + 1)
+			* screenHeight * KEYFRAME_CELL + KEYFRAME_CELL;
+		if (startBroadcast(&broadcast, address, port, keyframeSize,
+				writeKeyframe) != 0) {
+			goto noBroadcast;
+		}
+		broadcasting = 1;
+	}
+
+	renderInterval = 0;
+	nextPresent = 0;
+	presentPending = 0;
+	bandwidth = bytesPerSecond;
+	tokens = bandwidth / 10.0;
+	tokensTime = monotonicTime();
+
+	threaded = 0;
+	if (useThread) {
+		queue = malloc(QUEUE_SIZE * screenWidth * screenHeight
+				* sizeof(*queue));
+		if (queue == NULL) {
+			errno = ENOMEM;
+			goto noQueue;
+		}
+		if (pipe(wakeFds) != 0) {
+			goto noPipe;
+		}
+		fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+		fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+		queueHead = 0;
+		queueTail = 0;
+		renderStop = 0;
+		clearPending = 0;
+
+		/* Signals are left to the game's thread, so that the ^C
+		 * handler doesn't end up waiting on its own thread in
+		 * terminalEnd(). */
+		sigset_t all, old;
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		error = pthread_create(&renderThread, NULL, render, NULL);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if (error != 0) {
+			errno = error;
+			goto noThread;
+		}
+		threaded = 1;
+	}
+
+	setCursorVisibility(0);
+	/* The terminal stays in raw mode for the whole game, so that reading
+	 * input every frame doesn't have to change its settings. */
+	setRawMode(1);
+
+	/* A resize interrupts waiting for input, so that the screen is laid
+	 * out again right away. */
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = noteResize;
+	sigemptyset(&action.sa_mask);
+	resized = 0;
+	sigaction(SIGWINCH, &action, NULL);
+
+	inputEnded = 0;
+	termResume(&terminalInput, 1);
+	return 0;
+
+	/* What was set up before the failure is undone, in reverse. */
+noThread:
+	error = errno;
+	close(wakeFds[0]);
+	close(wakeFds[1]);
+	errno = error;
+noPipe:
+	free(queue);
+noQueue:
+	if (broadcasting) {
+		error = errno;
+		stopBroadcast(&broadcast);
+		broadcasting = 0;
+		errno = error;
+	}
+noBroadcast:
+	free(back);
+	free(front);
+	return -1;
+}
+
+/*
+ * Finds the biggest board that fits in the terminal, with its border and
+ * footer, and stores its size in width and height. Returns 0 on success, or -1
+ * if the size of the terminal isn't known, leaving width and height alone.
+ */
+int
+terminalSize(int *width, int *height)
+{
+	const int columns = tcols();
+	const int rows = trows();
+
+	if (columns <= 0 || rows <= 0) {
+		return -1;
+	}
+	/* There is a column to the right of the border, and a row below it,
+	 * for the cursor to sit in. */
+	*width = columns - 3;
+	*height = rows - 3;
+	return 0;
+}
+
+/*
+ * Clean up the modifications made to the terminal settings before quitting the
+ * program.
+ */
+void
+terminalEnd(void)
+{
+	/* The render thread sends the last screen it was given, and from here
+	 * on, output goes out the usual way. */
+	if (threaded) {
+		storeShared(&renderStop, 1);
+		if (write(wakeFds[1], "", 1) < 0) {
+			;
+		}
+		pthread_join(renderThread, NULL);
+		close(wakeFds[0]);
+		close(wakeFds[1]);
+		free(queue);
+		threaded = 0;
+	}
+	signal(SIGWINCH, SIG_DFL);
+	setCursorVisibility(1);
+	resetColor();
+	locate(1, offsetY + visibleHeight + 1);
+	/* Anything could happen to the cursor from here on. */
+	cursorX = 0;
+	cursorY = 0;
+	rutil_flush();
+	setRawMode(0);
+	if (broadcasting) {
+		stopBroadcast(&broadcast);
+		broadcasting = 0;
+	}
+	free(back);
+	free(front);
+	back = NULL;
+	front = NULL;
+}
+
+/*
+ * Puts the terminal back the way it was, from a signal handler that is about to
+ * exit the program. Only async-signal-safe calls are made, and nothing else is
+ * torn down, since the code that was interrupted could be in the middle of
+ * using any of it.
+ */
+void
+terminalRestore(void)
+{
+	/* CAN cuts short any control sequence that was half sent. Then the
+	 * colors are reset, the cursor is shown and it goes below the screen,
+	 * the way terminalEnd() leaves it. */
+	static const char reset[] = "\030\033[0m\033[?25h\033[";
+	char buf[sizeof(reset) + 16];
+	char digits[12];
+	int len = sizeof(reset) - 1, count = 0;
+	int row = offsetY + visibleHeight + 1;
+
+	memcpy(buf, reset, len);
+	do {
+		digits[count++] = (char)('0' + row % 10);
+		row /= 10;
+	} while (row > 0);
+	while (count > 0) {
+		buf[len++] = digits[--count];
+	}
+	buf[len++] = ';';
+	buf[len++] = '1';
+	buf[len++] = 'H';
+	if (write(STDOUT_FILENO, buf, len) < 0) {
+		;
+	}
+	setRawMode(0);
+}
+
+/*
+ * Updates the level counter in the footer.
+ */
+static void
+updateLevel(struct renderer *r, int level)
+{
+	(void)r;
+
+	drawCounter(&levelCounter, (unsigned long)level);
+}
+
+/*
+ * Updates the lives counter in the footer.
+ */
+static void
+updateLives(struct renderer *r, int lives)
+{
+	(void)r;
+
+	drawCounter(&livesCounter, (unsigned long)lives);
+}
+
+/*
+ * Updates the score counter in the footer.
+ */
+static void
+updateScore(struct renderer *r, unsigned int score)
+{
+	(void)r;
+
+	drawCounter(&scoreCounter, score);
+}
+
+/*
+ * Waits until there is input to read, for at most timeout milliseconds, or
+ * forever if timeout is -1, as kbwait() does. Returns 1 if there is input (or
+ * the end of it), or 0 if the wait timed out or was interrupted by a signal.
+ * Without a render thread to see to them, viewers of the broadcast are sent
+ * what they are waiting for in the meantime, so that they don't have to wait
+ * for the player.
+ */
+static int
+waitForInput(int timeout)
+{
+	if (!broadcasting || threaded) {
+		return kbwait(timeout);
+	}
+
+	const long long deadline = monotonicTime()
+		+ (long long)timeout * 1000000;
+	for (;;) {
+		struct pollfd p[1 + BROADCAST_FDS] = {
+			{ STDIN_FILENO, POLLIN, 0 }
+		};
+		const int count = 1 + broadcastFds(&broadcast, p + 1);
+		int left = timeout;
+		if (timeout > 0) {
+			/* Round up, as termWait() does. */
+			const long long ns = deadline - monotonicTime();
+			left = ns > 0 ? (int)((ns + 999999) / 1000000) : 0;
+		}
+		const int ready = poll(p, count, left);
+		INSTRUMENT_SYSCALL(0);
+		if (ready <= 0) {
+			return 0;
+		}
+		if (p[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			return 1;
+		}
+		broadcastFrame(&broadcast);
+	}
+}
+
+/*
+ * Writes into buf, which is size bytes long, what it takes to draw the screen
+ * as the terminal has it from scratch, for a viewer of the broadcast. It is
+ * left with the cursor where it is on the terminal, and the colors reset, as
+ * sendScreen() leaves them. Returns the length.
+ */
+static size_t
+writeKeyframe(char *buf, size_t size)
+{
+	/* A CAN first cuts off any escape sequence that a viewer was part way
+	 * through when it fell behind. */
+	const char start[] = "\030\033[0m\033[2J\033[H";
+	const char reset[] = "\033[0m";
+	size_t len = sizeof(start) - 1;
+	int fg = -1, bg = -1;
+
+	memcpy(buf, start, len);
+	for (int y = 0; y < visibleHeight; y++) {
+		if (size - len < (size_t)(visibleWidth + 1) * KEYFRAME_CELL) {
+			break;
+		}
+		len += sprintf(buf + len, "\033[%d;%df", y + 1 + offsetY,
+				1 + offsetX);
+		for (int x = 0; x < visibleWidth; x++) {
+			const struct cell *c = &front[y * screenWidth + x];
+			if (c->fg != fg || c->bg != bg) {
+				memcpy(buf + len, reset, sizeof(reset) - 1);
+				len += sizeof(reset) - 1;
+				if (c->fg >= 0) {
+					len += sprintf(buf + len, "%s",
+							getANSIColor(c->fg));
+				}
+				if (c->bg >= 0) {
+					len += sprintf(buf + len, "%s",
+							getANSIBgColor(c->bg));
+				}
+				fg = c->fg;
+				bg = c->bg;
+			}
+			buf[len++] = c->ch;
+		}
+	}
+	memcpy(buf + len, reset, sizeof(reset) - 1);
+	len += sizeof(reset) - 1;
+	if (cursorX != 0) {
+		len += sprintf(buf + len, "\033[%d;%df", cursorY + offsetY,
+				cursorX + offsetX);
+	}
+	return len;
+}
@@ -0,0 +1,56 @@
+/*
+ * ascii-breakout - a TUI Breakout game
+ * Copyright (C) 2020-2021 Sebastian LaVine <mail@smlavine.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Playing the game in a terminal. This is the only part of the game that uses
+ * rogueutil.
+ */
+
+#ifndef TERM_H
+#define TERM_H
+
+#include "game.h"
+
+/*
+ * Draws the game on the terminal.
+ */
+extern struct renderer terminalRenderer;
+
+/*
+ * Reads the keyboard, with frames timed by the real clock.
+ */
+extern struct input terminalInput;
+
+/*
+ * Length of a frame, in nanoseconds.
+ */
+extern const long long FRAME_LENGTH;
+
+/*
+ * The bandwidth limit for --low-bandwidth, in bytes per second.
+ */
+extern const long LOW_BANDWIDTH;
+
+long long monotonicTime(void);
+int terminalBegin(int width, int height, long bytesPerSecond,
+		int useThread, const char *address, int port);
+void terminalEnd(void);
+void terminalRestore(void);
+int terminalSize(int *width, int *height);
+
+#endif /* TERM_H */